@@ -4,16 +4,24 @@ uniform mat4 u_local_to_clip;
 uniform mat4 u_local_to_view;
 
 layout(location = 0) in vec3 a_position;
-layout(location = 1) in vec3 a_normal;
+layout(location = 1) in vec2 a_normal; // Octahedral encoding
 layout(location = 2) in float a_scalar;
 
 out vec3 v_view_normal;
 out float v_scalar;
 
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() 
 {
     gl_Position = u_local_to_clip * vec4(a_position, 1.0);
     // NOTE(dr): This assumes local_to_view has uniform scaling
-    v_view_normal = normalize(mat3(u_local_to_view) * a_normal);
+    v_view_normal = normalize(mat3(u_local_to_view) * decode_octahedral(a_normal));
     v_scalar = a_scalar;
 }
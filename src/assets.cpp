@@ -1,15 +1,17 @@
 #include "assets.hpp"
 
-#include <stb_image.h>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
 
-#include <dr/linalg_reshape.hpp>
-#include <dr/mesh_attributes.hpp>
+#include <stb_image.h>
 
 #include <dr/app/asset_cache.hpp>
 #include <dr/app/file_utils.hpp>
 #include <dr/string.hpp>
 
-#include "shim/happly.hpp"
+#include "mesh_gen.hpp"
+#include "mesh_io.hpp"
 
 namespace dr
 {
@@ -32,11 +34,58 @@ char const* asset_path(AssetHandle::Mesh const handle)
         "assets/models/chen-gackstatter-surface.ply",
         "assets/models/node-cluster.ply",
         "assets/models/armadillo-remesh.ply",
+        // NOTE(dr): Generated meshes don't have a file so these only serve as cache keys
+        "generated/icosphere",
+        "generated/ring-torus",
+        "generated/genus-5",
     };
     static_assert(size(paths) == AssetHandle::_Mesh_Count);
     return paths[handle];
 }
 
+/// Returns the cache key of a mesh at the given refinement level (i.e. its path followed by the
+/// level and an 'r' if it's reordered)
+String mesh_key(AssetHandle::Mesh const handle, i32 const refine_level, bool const reorder)
+{
+    static_assert(AssetHandle::max_mesh_refine_level < 10);
+    assert(refine_level >= 0 && refine_level <= AssetHandle::max_mesh_refine_level);
+
+    String key{asset_path(handle)};
+    key += '#';
+    key += char('0' + refine_level);
+
+    if (reorder)
+        key += 'r';
+
+    return key;
+}
+
+bool parse_mesh_key(
+    String const& key,
+    AssetHandle::Mesh& handle,
+    i32& refine_level,
+    bool& reorder)
+{
+    char const* const sep = std::strrchr(key.c_str(), '#');
+    if (sep == nullptr)
+        return false;
+
+    isize const path_len = sep - key.c_str();
+    for (u8 i = 0; i < AssetHandle::_Mesh_Count; ++i)
+    {
+        char const* const path = asset_path(AssetHandle::Mesh{i});
+        if (std::strncmp(path, key.c_str(), path_len) == 0 && path[path_len] == '\0')
+        {
+            handle = AssetHandle::Mesh{i};
+            refine_level = std::atoi(sep + 1);
+            reorder = std::strchr(sep + 1, 'r') != nullptr;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 char const* asset_path(AssetHandle::Image const handle)
 {
     static constexpr char const* paths[]{
@@ -58,127 +107,62 @@ char const* asset_path(AssetHandle::Shader const handle)
     return paths[handle];
 }
 
-bool read_mesh_ply(char const* path, MeshAsset& asset)
+bool make_mesh(AssetHandle::Mesh const handle, i32 const refine_level, MeshAsset& asset)
 {
-    using namespace happly;
-
-    try
+    switch (handle)
     {
-        PLYData ply{path};
-        ply.validate();
-
-        // Assign vertex attributes
+        case AssetHandle::Mesh_Icosphere:
         {
-            auto& ply_verts = ply.getElement("vertex");
-
-            // Positions
-            {
-                Span<f32 const> const x = get_property_data<f32>(ply_verts, "x");
-                Span<f32 const> const y = get_property_data<f32>(ply_verts, "y");
-                Span<f32 const> const z = get_property_data<f32>(ply_verts, "z");
-
-                if (!(x.is_valid() && y.is_valid() && z.is_valid()))
-                    return false;
-
-                auto& dst = asset.vertices.positions;
-                dst.resize(3, ply_verts.count);
-                dst.row(0) = as_covec(x);
-                dst.row(1) = as_covec(y);
-                dst.row(2) = as_covec(z);
-            }
-
-            // Texture coords (optional)
-            {
-                Span<f32 const> const u = get_property_data<f32>(ply_verts, "uv1");
-                Span<f32 const> const v = get_property_data<f32>(ply_verts, "uv2");
-
-                auto& dst = asset.vertices.tex_coords;
-                dst.resize(2, ply_verts.count);
-
-                if (u.is_valid())
-                    dst.row(0) = as_covec(u);
-                else
-                    dst.row(0).setConstant(0.0f);
-
-                if (v.is_valid())
-                    dst.row(1) = as_covec(v);
-                else
-                    dst.row(1).setConstant(0.0f);
-            }
+            make_icosphere(5 + refine_level, asset);
+            return true;
         }
-
-        // Assign face attributes
+        case AssetHandle::Mesh_RingTorus:
         {
-            auto& ply_faces = ply.getElement("face");
-
-            // Vertex IDs
-            {
-                // NOTE(dr): We check a few different naming conventions here
-                static constexpr char const* prop_names[]{
-                    "vertex_indices", // Used by Blender and Houdini
-                    "vertex_index", // Used by Rhino
-                    // ...
-                };
-
-                Property* prop{};
-                for (auto name : prop_names)
-                {
-                    prop = get_property(ply_faces, name);
-                    if (prop != nullptr)
-                        break;
-                }
-
-                if (prop == nullptr)
-                    return false;
-
-                Span<i32 const> prop_data = get_list_property_data<i32>(prop);
-
-                if (!prop_data.is_valid())
-                    prop_data = as<i32>(get_list_property_data<u32>(prop));
-
-                if (!prop_data.is_valid())
-                    return false;
-
-                asset.faces.vertex_ids = as_mat(prop_data, 3);
-            }
+            isize const scale = isize{1} << refine_level;
+            make_torus(96 * scale, 24 * scale, 1.0f, 0.25f, asset);
+            return true;
         }
-    }
-    catch (...)
-    {
-        return false;
-    }
+        case AssetHandle::Mesh_Genus5:
+        {
+            // NOTE(dr): The base surface is coarse with sharp edges so it's always smoothed a few
+            // times on top of the requested level
+            make_genus_surface(5, 2, asset);
+            for (i32 i = 0; i < refine_level + 2; ++i)
+                refine_loop(asset);
 
-    return true;
-}
+            return true;
+        }
+        default:
+        {
+            if (!read_mesh_ply(asset_path(handle), asset))
+                return false;
 
-void compute_bounds(MeshAsset& asset)
-{
-    asset.bounds.center = area_centroid(
-        as_span(asset.vertices.positions).as_const(),
-        as_span(asset.faces.vertex_ids).as_const());
+            for (i32 i = 0; i < refine_level; ++i)
+                refine_loop(asset);
 
-    asset.bounds.radius = bounding_radius(
-        as_span(asset.vertices.positions).as_const(),
-        asset.bounds.center);
+            return true;
+        }
+    }
 }
 
-void compute_vertex_normals(MeshAsset& asset)
+bool load_mesh(String const& key, MeshAsset& asset)
 {
-    auto& normals = asset.vertices.normals;
-    normals.resize(3, asset.vertices.count());
+    AssetHandle::Mesh handle;
+    i32 refine_level;
+    bool reorder;
 
-    vertex_normals_area_weighted(
-        as_span(asset.vertices.positions).as_const(),
-        as_span(asset.faces.vertex_ids).as_const(),
-        as_span(normals));
-}
-
-bool load_mesh(String const& path, MeshAsset& asset)
-{
-    if (read_mesh_ply(path.c_str(), asset))
+    if (parse_mesh_key(key, handle, refine_level, reorder)
+        && make_mesh(handle, refine_level, asset))
     {
+        // NOTE(dr): Reordering improves memory locality in the solver's per-face loops and
+        // reduces the bandwidth of the Laplacian. See reorder_mesh.
+        if (reorder)
+            reorder_mesh(asset);
+
         compute_vertex_normals(asset);
         compute_bounds(asset);
+        compute_clusters(asset);
+        compute_lods(asset);
         return true;
     }
     return false;
@@ -211,7 +195,16 @@ bool load_shader(String const& path, ShaderAsset& asset)
 
 MeshAsset const* get_asset(AssetHandle::Mesh const handle, bool const force_reload)
 {
-    return state.meshes.get(asset_path(handle), load_mesh, force_reload);
+    return get_asset(handle, 0, true, force_reload);
+}
+
+MeshAsset const* get_asset(
+    AssetHandle::Mesh const handle,
+    i32 const refine_level,
+    bool const reorder,
+    bool const force_reload)
+{
+    return state.meshes.get(mesh_key(handle, refine_level, reorder), load_mesh, force_reload);
 }
 
 ImageAsset const* get_asset(AssetHandle::Image const handle, bool const force_reload)
@@ -224,7 +217,14 @@ ShaderAsset const* get_asset(AssetHandle::Shader const handle, bool const force_
     return state.shaders.get(asset_path(handle), load_shader, force_reload);
 }
 
-void release_asset(AssetHandle::Mesh const handle) { state.meshes.remove(asset_path(handle)); }
+void release_asset(AssetHandle::Mesh const handle)
+{
+    for (i32 i = 0; i <= AssetHandle::max_mesh_refine_level; ++i)
+    {
+        state.meshes.remove(mesh_key(handle, i, false));
+        state.meshes.remove(mesh_key(handle, i, true));
+    }
+}
 
 void release_asset(AssetHandle::Image const handle) { state.images.remove(asset_path(handle)); }
 
@@ -3,6 +3,7 @@
 #include <memory>
 
 #include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
 #include <dr/math_types.hpp>
 #include <dr/string.hpp>
 
@@ -19,10 +20,16 @@ struct AssetHandle
         Mesh_ChenGackstatter,
         Mesh_NodeCluster,
         Mesh_Armadillo,
+        Mesh_Icosphere, // Generated
+        Mesh_RingTorus, // Generated
+        Mesh_Genus5, // Generated
         // Mesh_Custom, // TODO(dr)
         _Mesh_Count,
     };
 
+    /// Meshes can be refined up to this level. Each level has 4 times as many faces as the last.
+    static constexpr i32 max_mesh_refine_level{5};
+
     enum Image : u8
     {
         Image_Matcap = 0,
@@ -46,6 +53,7 @@ struct MeshAsset
         VecArray<f32, 3> positions{};
         VecArray<f32, 3> normals{};
         VecArray<f32, 2> tex_coords{};
+        DynamicArray<i32> source_ids{}; // Index in the source file (empty if not reordered)
         isize count() const { return positions.cols(); };
     } vertices;
 
@@ -55,6 +63,25 @@ struct MeshAsset
         isize count() const { return vertex_ids.cols(); }
     } faces;
 
+    // Groups of consecutive faces for culling. Faces are sorted such that each cluster is
+    // spatially coherent.
+    struct
+    {
+        DynamicArray<i32> offsets{}; // Start of each cluster followed by the total number of faces
+        VecArray<f32, 4> spheres{}; // Bounding sphere of each cluster (center, radius)
+        VecArray<f32, 4> cones{}; // Normal cone of each cluster (axis, sine of half angle)
+        isize count() const { return spheres.cols(); }
+    } clusters;
+
+    // Coarser levels of detail for drawing. Each level indexes a subset of the mesh's vertices.
+    struct
+    {
+        VecArray<i32, 3> vertex_ids{}; // Faces of all levels from finest to coarsest
+        DynamicArray<i32> offsets{}; // Start of each level followed by the total number of faces
+        DynamicArray<f32> errors{}; // Bound on the geometric error of each level
+        isize count() const { return size(errors); }
+    } lods;
+
     struct
     {
         Vec3<f32> center{Vec3<f32>::Zero()};
@@ -79,6 +106,16 @@ struct ShaderAsset
 
 MeshAsset const* get_asset(AssetHandle::Mesh const handle, bool const force_reload = false);
 
+/// Returns the mesh refined to the given level. Generated meshes are created at a higher
+/// resolution and others are refined via Loop subdivision. If reorder is set, vertices and faces
+/// are reordered for memory locality after loading.
+MeshAsset const* get_asset(
+    AssetHandle::Mesh const handle,
+    i32 const refine_level,
+    bool const reorder = true,
+    bool const force_reload = false);
+
+/// Releases the mesh at all refinement levels (reordered or not)
 void release_asset(AssetHandle::Mesh const handle);
 
 ImageAsset const* get_asset(AssetHandle::Image const handle, bool const force_reload = false);
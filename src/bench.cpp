@@ -0,0 +1,482 @@
+/*
+    Benchmarks the phases of loading a mesh and computing geodesic distance via the heat method.
+    Runs on the bundled meshes by default along with midpoint refinements of each up to a given
+    face count. Results are written as JSON.
+
+    Generated meshes can be given in place of paths as gen:icosphere, gen:torus or gen:genus-<g>.
+
+    Usage
+    geodesic-heat-bench [-o <output path>] [-r <repeats>] [-f <max faces>] [<mesh path> ...]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+#include <dr/string.hpp>
+
+#include "diffusion_time.hpp"
+#include "heat_method.hpp"
+#include "isolines.hpp"
+#include "memory_stats.hpp"
+#include "mesh_gen.hpp"
+#include "mesh_io.hpp"
+#include "profile.hpp"
+
+namespace dr
+{
+namespace
+{
+
+enum Phase : u8
+{
+    Phase_ReadMesh = 0,
+    Phase_GenerateMesh,
+    Phase_RefineMesh,
+    Phase_ReorderMesh,
+    Phase_ComputeAttributes,
+    Phase_Assemble,
+    Phase_DecompDistance,
+    Phase_DecompHeat,
+    Phase_RefactorHeat,
+    Phase_SolveHeat,
+    Phase_Divergence,
+    Phase_SolvePoisson,
+    Phase_UpdatePositions,
+    Phase_ExtractIsolines,
+    _Phase_Count,
+};
+
+char const* phase_name(Phase const phase)
+{
+    static constexpr char const* names[]{
+        "read_mesh_ply",
+        "generate_mesh",
+        "refine_midpoint",
+        "reorder_mesh",
+        "compute_attributes",
+        "assemble",
+        "decomp_distance",
+        "decomp_heat",
+        "refactor_heat",
+        "solve_heat",
+        "divergence",
+        "solve_poisson",
+        "update_positions",
+        "extract_isolines",
+    };
+    static_assert(size(names) == _Phase_Count);
+    return names[phase];
+}
+
+struct Config
+{
+    char const* output_path{"bench.json"};
+    isize num_repeats{5};
+    isize max_faces{4'000'000};
+    DynamicArray<char const*> mesh_paths{};
+};
+
+struct Result
+{
+    String mesh{};
+    isize refine_level{};
+    isize num_vertices{};
+    isize num_faces{};
+    f32 time{};
+    f64 phase_times[_Phase_Count]{}; // Median time of each phase in ms (negative if not run)
+    usize peak_memory{};
+    bool ok{};
+};
+
+constexpr char const* default_mesh_paths[]{
+    "assets/models/torus.ply",
+    "assets/models/double-torus.ply",
+    "assets/models/triple-torus.ply",
+    "assets/models/chen-gackstatter-surface.ply",
+    "assets/models/node-cluster.ply",
+    "assets/models/armadillo-remesh.ply",
+};
+
+/// Calls the given function the given number of times and returns the median time taken in ms
+template <typename Func>
+f64 time_median(isize const num_repeats, Func&& func)
+{
+    using Clock = std::chrono::steady_clock;
+    using Millis = std::chrono::duration<f64, std::milli>;
+
+    DynamicArray<f64> times(num_repeats);
+    for (auto& t : times)
+    {
+        auto const start = Clock::now();
+        func();
+        t = Millis{Clock::now() - start}.count();
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[num_repeats / 2];
+}
+
+String mesh_name(char const* const path)
+{
+    char const* start = std::strrchr(path, '/');
+    start = (start) ? start + 1 : path;
+
+    char const* end = std::strrchr(start, '.');
+    return (end) ? String{start, end} : String{start};
+}
+
+constexpr char const generated_prefix[]{"gen:"};
+
+/// Generates a mesh from its name (without the prefix). Sizes match the generated assets in the app
+/// at refinement level 0.
+bool generate_mesh(char const* const name, MeshAsset& mesh)
+{
+    if (std::strcmp(name, "icosphere") == 0)
+    {
+        make_icosphere(5, mesh);
+        return true;
+    }
+
+    if (std::strcmp(name, "torus") == 0)
+    {
+        make_torus(96, 24, 1.0f, 0.25f, mesh);
+        return true;
+    }
+
+    if (std::strncmp(name, "genus-", 6) == 0)
+    {
+        isize const genus = std::atol(name + 6);
+        if (genus < 0)
+            return false;
+
+        make_genus_surface(genus, 2, mesh);
+        refine_loop(mesh);
+        refine_loop(mesh);
+        return true;
+    }
+
+    return false;
+}
+
+/// Returns the median of the most recent durations recorded for the given profile zone in ms
+/// (negative if none were recorded). Only the last profile_history_size durations are kept.
+f64 zone_median(ProfileZone const zone, isize const num_repeats)
+{
+    ProfileZoneStats stats{};
+    get_profile_stats(zone, stats);
+
+    isize const n = min(min(num_repeats, profile_history_size), isize(stats.count));
+    if (n == 0)
+        return -1.0;
+
+    f32* const first = std::end(stats.history) - n;
+    std::sort(first, first + n);
+    return first[n / 2];
+}
+
+/// Times each phase of the heat method on the given mesh via the zones recorded by HeatMethod
+bool bench_heat_method(MeshAsset const& mesh, isize const num_repeats, Result& result)
+{
+    auto const vert_coords = as_span(mesh.vertices.positions).as_const();
+    auto const face_verts = as_span(mesh.faces.vertex_ids).as_const();
+    isize const n_v = vert_coords.size();
+
+    HeatMethod<f32, i32> solver{};
+    HeatMethod<f32, i32>::Workspace workspace{};
+
+    i32 const sources[]{0};
+    DynamicArray<f32> dist(n_v);
+
+    auto const solve = [&]() -> bool {
+        solver.solve(as_span(sources), as_span(dist), workspace);
+        return workspace.is_solved() && as_vec(as_span(dist)).allFinite();
+    };
+
+    // Find a time that works before timing anything
+    {
+        i32 num_retries = 0;
+        bool const ok = init_with_retry(solver, vert_coords, face_verts, result.time, num_retries)
+            && solve_with_retry(solver, result.time, num_retries, solve);
+
+        if (!ok)
+            return false;
+    }
+
+    reset_profile();
+    for (isize i = 0; i < num_repeats; ++i)
+        solver.init(vert_coords, face_verts, result.time);
+
+    result.phase_times[Phase_Assemble] = zone_median(ProfileZone_HeatMethodAssemble, num_repeats);
+    result.phase_times[Phase_DecompDistance] = zone_median(
+        ProfileZone_HeatMethodDecompDistance,
+        num_repeats);
+    result.phase_times[Phase_DecompHeat] = zone_median(
+        ProfileZone_HeatMethodDecompHeat,
+        num_repeats);
+
+    // NOTE(dr): Unlike init, reinit reuses the symbolic factorization of the heat operator
+    reset_profile();
+    for (isize i = 0; i < num_repeats; ++i)
+        solver.reinit(result.time);
+
+    result.phase_times[Phase_RefactorHeat] = zone_median(
+        ProfileZone_HeatMethodDecompHeat,
+        num_repeats);
+
+    reset_profile();
+    bool ok = true;
+    for (isize i = 0; i < num_repeats; ++i)
+        ok &= solve();
+
+    if (!ok)
+        return false;
+
+    result.phase_times[Phase_SolveHeat] = zone_median(ProfileZone_HeatMethodSolveHeat, num_repeats);
+    result.phase_times[Phase_Divergence] = zone_median(
+        ProfileZone_HeatMethodDivergence,
+        num_repeats);
+    result.phase_times[Phase_SolvePoisson] = zone_median(
+        ProfileZone_HeatMethodSolvePoisson,
+        num_repeats);
+
+    // Extract isolines at evenly spaced values across the range of distance
+    {
+        constexpr isize num_isovalues = 32;
+        f32 const max_dist = as_vec(as_span(dist)).maxCoeff();
+
+        DynamicArray<f32> isovalues(num_isovalues);
+        for (isize i = 0; i < num_isovalues; ++i)
+            isovalues[i] = max_dist * (i + 1) / (num_isovalues + 1);
+
+        Isolines<f32, i32> isolines{};
+        IsolineWorkspace<i32> iso_ws{};
+
+        reset_profile();
+        for (isize i = 0; i < num_repeats; ++i)
+        {
+            extract_isolines(
+                face_verts,
+                as_span(dist).as_const(),
+                as_span(isovalues).as_const(),
+                isolines,
+                iso_ws);
+        }
+
+        result.phase_times[Phase_ExtractIsolines] = zone_median(
+            ProfileZone_ExtractIsolines,
+            num_repeats);
+    }
+
+    // Time the per-frame update of a deforming mesh (i.e. everything redone by init except the
+    // symbolic factorizations)
+    result.phase_times[Phase_UpdatePositions] = time_median(num_repeats, [&]() {
+        solver.update_positions(vert_coords, result.time);
+    });
+
+    return true;
+}
+
+void bench_mesh(MeshAsset const& mesh, isize const num_repeats, Result& result)
+{
+    result.num_vertices = mesh.vertices.count();
+    result.num_faces = mesh.faces.count();
+
+    {
+        MeshAsset copy = mesh;
+        result.phase_times[Phase_ComputeAttributes] = time_median(num_repeats, [&]() {
+            compute_vertex_normals(copy);
+            compute_bounds(copy);
+        });
+    }
+
+    result.time = default_time(
+        as_span(mesh.vertices.positions).as_const(),
+        as_span(mesh.faces.vertex_ids).as_const());
+
+    result.ok = bench_heat_method(mesh, num_repeats, result);
+    result.peak_memory = peak_memory_bytes();
+}
+
+/// Times reordering of the given mesh and applies it
+void bench_reorder(MeshAsset& mesh, isize const num_repeats, Result& result)
+{
+    MeshAsset copy{};
+    result.phase_times[Phase_ReorderMesh] = time_median(num_repeats, [&]() {
+        copy = mesh;
+        reorder_mesh(copy);
+    });
+
+    mesh = std::move(copy);
+}
+
+void run(Config const& config, DynamicArray<Result>& results)
+{
+    for (auto const path : config.mesh_paths)
+    {
+        Result result{};
+        std::fill(std::begin(result.phase_times), std::end(result.phase_times), -1.0);
+        result.mesh = mesh_name(path);
+
+        isize const prefix_len = size(generated_prefix) - 1;
+        bool const is_generated = std::strncmp(path, generated_prefix, prefix_len) == 0;
+        Phase const load_phase = (is_generated) ? Phase_GenerateMesh : Phase_ReadMesh;
+
+        MeshAsset mesh{};
+        bool read_ok = true;
+        result.phase_times[load_phase] = time_median(config.num_repeats, [&]() {
+            mesh = {};
+            read_ok &= (is_generated) ? generate_mesh(path + prefix_len, mesh)
+                                      : read_mesh_ply(path, mesh);
+        });
+
+        if (!read_ok)
+        {
+            std::fprintf(stderr, "Failed to load mesh \"%s\"\n", path);
+            results.push_back(result);
+            continue;
+        }
+
+        bench_reorder(mesh, config.num_repeats, result);
+
+        while (true)
+        {
+            bench_mesh(mesh, config.num_repeats, result);
+            results.push_back(result);
+
+            std::printf(
+                "%s (level %td): %td faces, %s\n",
+                result.mesh.c_str(),
+                result.refine_level,
+                result.num_faces,
+                result.ok ? "ok" : "failed");
+
+            if (mesh.faces.count() * 4 > config.max_faces)
+                break;
+
+            // Refined meshes don't come from a file or generator
+            result.phase_times[load_phase] = -1.0;
+
+            // NOTE(dr): Refinement is slow relative to other phases at this size so it's only
+            // done once
+            result.phase_times[Phase_RefineMesh] = time_median(1, [&]() { refine_midpoint(mesh); });
+            bench_reorder(mesh, config.num_repeats, result);
+            ++result.refine_level;
+        }
+    }
+}
+
+bool write_json(char const* const path, Config const& config, Span<Result const> const& results)
+{
+    FILE* const file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "{\n");
+    std::fprintf(file, "  \"num_repeats\": %td,\n", config.num_repeats);
+    std::fprintf(file, "  \"results\": [\n");
+
+    for (isize i = 0; i < results.size(); ++i)
+    {
+        Result const& r = results[i];
+
+        std::fprintf(file, "    {\n");
+        std::fprintf(file, "      \"mesh\": \"%s\",\n", r.mesh.c_str());
+        std::fprintf(file, "      \"refine_level\": %td,\n", r.refine_level);
+        std::fprintf(file, "      \"num_vertices\": %td,\n", r.num_vertices);
+        std::fprintf(file, "      \"num_faces\": %td,\n", r.num_faces);
+        std::fprintf(file, "      \"time\": %g,\n", r.time);
+        std::fprintf(file, "      \"ok\": %s,\n", r.ok ? "true" : "false");
+        std::fprintf(file, "      \"peak_memory_bytes\": %zu,\n", r.peak_memory);
+        std::fprintf(file, "      \"timings_ms\": {");
+
+        // Phases that weren't run are omitted
+        char const* sep = "\n";
+        for (u8 j = 0; j < _Phase_Count; ++j)
+        {
+            if (r.phase_times[j] < 0.0)
+                continue;
+
+            std::fprintf(
+                file,
+                "%s        \"%s\": %.4f",
+                sep,
+                phase_name(Phase{j}),
+                r.phase_times[j]);
+            sep = ",\n";
+        }
+
+        std::fprintf(file, "\n      }\n");
+        std::fprintf(file, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+
+    std::fprintf(file, "  ]\n");
+    std::fprintf(file, "}\n");
+
+    return std::fclose(file) == 0;
+}
+
+bool parse_args(int const argc, char* argv[], Config& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* const arg = argv[i];
+        bool const has_value = (i + 1 < argc);
+
+        if (std::strcmp(arg, "-o") == 0 && has_value)
+            config.output_path = argv[++i];
+        else if (std::strcmp(arg, "-r") == 0 && has_value)
+            config.num_repeats = std::max(std::atol(argv[++i]), 1L);
+        else if (std::strcmp(arg, "-f") == 0 && has_value)
+            config.max_faces = std::atol(argv[++i]);
+        else if (arg[0] == '-')
+            return false;
+        else
+            config.mesh_paths.push_back(arg);
+    }
+
+    if (config.mesh_paths.empty())
+        config.mesh_paths.assign(std::begin(default_mesh_paths), std::end(default_mesh_paths));
+
+    return true;
+}
+
+} // namespace
+} // namespace dr
+
+int main(int argc, char* argv[])
+{
+    using namespace dr;
+
+    Config config{};
+    if (!parse_args(argc, argv, config))
+    {
+        std::fprintf(
+            stderr,
+            "Usage: %s [-o <output path>] [-r <repeats>] [-f <max faces>] [<mesh path> ...]\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    DynamicArray<Result> results{};
+    run(config, results);
+
+    if (!write_json(config.output_path, config, as_span(results)))
+    {
+        std::fprintf(stderr, "Failed to write results to \"%s\"\n", config.output_path);
+        return EXIT_FAILURE;
+    }
+
+    bool const all_ok = std::all_of(results.begin(), results.end(), [](Result const& r) {
+        return r.ok;
+    });
+
+    return all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,515 @@
+/*
+    Computes geodesic distance from one or more source vertices on a mesh and writes the result
+    with one value per vertex (in file order) per line
+
+    With --log-map, each line also has the coordinates of the logarithmic map at the first source
+    vertex (via the vector heat method) i.e. "<distance> <x> <y>"
+
+    With --isolines, isolines of distance at each value given by -i are also written to a separate
+    file. Each polyline starts with a line "<isovalue> <num points> <closed>" followed by one line
+    per point "<x> <y> <z> <a> <b> <c> <u> <v> <w>" where a, b and c are the vertices (in file
+    order) of the face containing the point and u, v and w are its barycentric coordinates.
+
+    With --paths, geodesic paths from each vertex given by -p to the nearest source are written to
+    a separate file. Each path starts with a line "<reached source> <num points>" followed by one
+    line per point as above.
+
+    With --time, the given diffusion time is used as is rather than the default time scaled by -t.
+    It's still grown if the solve fails.
+
+    With --quantize, distance is instead written in binary as the max distance (f32) followed by
+    one u16 per vertex (in file order) where 65535 maps to the max distance. Both are little endian
+    on the platforms we target. This can't be combined with --log-map.
+
+    Usage
+    geodesic-heat-cli <mesh path> [-s <source vertex>]... [-t <time scale>] [--time <time>]
+        [-o <output path>] [-i <isovalue>]... [--isolines <output path>] [-p <path vertex>]...
+        [--paths <output path>] [--log-map] [--quantize] [--stats]
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+
+#include "diffusion_time.hpp"
+#include "geodesic_paths.hpp"
+#include "heat_method.hpp"
+#include "isolines.hpp"
+#include "memory_stats.hpp"
+#include "mesh_io.hpp"
+#include "quantize.hpp"
+
+namespace dr
+{
+namespace
+{
+
+struct Config
+{
+    char const* mesh_path{};
+    char const* output_path{};
+    char const* isolines_path{};
+    char const* paths_path{};
+    DynamicArray<i32> source_vertices{};
+    DynamicArray<f32> isovalues{};
+    DynamicArray<i32> path_vertices{};
+    f32 time_scale{1.0f};
+    f32 time{}; // Overrides time_scale if positive
+    bool log_map{};
+    bool quantize{};
+    bool print_stats{};
+};
+
+bool parse_args(int const argc, char* argv[], Config& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* const arg = argv[i];
+        bool const has_value = (i + 1 < argc);
+
+        if (std::strcmp(arg, "-s") == 0 && has_value)
+            config.source_vertices.push_back(std::atoi(argv[++i]));
+        else if (std::strcmp(arg, "-t") == 0 && has_value)
+            config.time_scale = std::atof(argv[++i]);
+        else if (std::strcmp(arg, "--time") == 0 && has_value)
+            config.time = std::atof(argv[++i]);
+        else if (std::strcmp(arg, "-o") == 0 && has_value)
+            config.output_path = argv[++i];
+        else if (std::strcmp(arg, "-i") == 0 && has_value)
+            config.isovalues.push_back(std::atof(argv[++i]));
+        else if (std::strcmp(arg, "--isolines") == 0 && has_value)
+            config.isolines_path = argv[++i];
+        else if (std::strcmp(arg, "-p") == 0 && has_value)
+            config.path_vertices.push_back(std::atoi(argv[++i]));
+        else if (std::strcmp(arg, "--paths") == 0 && has_value)
+            config.paths_path = argv[++i];
+        else if (std::strcmp(arg, "--log-map") == 0)
+            config.log_map = true;
+        else if (std::strcmp(arg, "--quantize") == 0)
+            config.quantize = true;
+        else if (std::strcmp(arg, "--stats") == 0)
+            config.print_stats = true;
+        else if (arg[0] == '-' || config.mesh_path != nullptr)
+            return false;
+        else
+            config.mesh_path = arg;
+    }
+
+    if (config.source_vertices.empty())
+        config.source_vertices.push_back(0);
+
+    // Isovalues are only used with an isolines path and vice versa
+    if (config.isovalues.empty() != (config.isolines_path == nullptr))
+        return false;
+
+    if (config.path_vertices.empty() != (config.paths_path == nullptr))
+        return false;
+
+    if (config.quantize && config.log_map)
+        return false;
+
+    std::sort(config.isovalues.begin(), config.isovalues.end());
+
+    return config.mesh_path != nullptr && config.time_scale > 0.0f && config.time >= 0.0f;
+}
+
+void print_stats(
+    MeshAsset const& mesh,
+    HeatMethod<f32, i32> const& solver,
+    HeatMethod<f32, i32>::Workspace const& workspace)
+{
+    auto const to_mb = [](usize const bytes) -> f64 { return bytes / (1024.0 * 1024.0); };
+    HeatMethodStats const st = solver.stats();
+
+    std::fprintf(
+        stderr,
+        "Mesh: %td vertices, %td faces (%.2f MB)\n",
+        mesh.vertices.count(),
+        mesh.faces.count(),
+        to_mb(memory_bytes(mesh)));
+
+    std::fprintf(
+        stderr,
+        "Nonzeros in S, A, A (Dirichlet): %td, %td, %td\n",
+        st.nnz_stiffness,
+        st.nnz_heat,
+        st.nnz_heat_dirichlet);
+
+    std::fprintf(
+        stderr,
+        "Nonzeros in L (heat, Dirichlet, distance): %td, %td, %td\n",
+        st.nnz_heat_factor,
+        st.nnz_heat_dirichlet_factor,
+        st.nnz_distance_factor);
+
+    std::fprintf(
+        stderr,
+        "Solver: %.2f MB (matrices %.2f MB, factors %.2f MB, buffers %.2f MB)\n",
+        to_mb(st.total_bytes()),
+        to_mb(st.matrix_bytes),
+        to_mb(st.factor_bytes),
+        to_mb(st.buffer_bytes));
+
+    std::fprintf(stderr, "Workspace: %.2f MB\n", to_mb(workspace.memory_bytes()));
+    std::fprintf(stderr, "Peak memory: %.2f MB\n", to_mb(peak_memory_bytes()));
+}
+
+bool write_distance(
+    char const* const path,
+    MeshAsset const& mesh,
+    Span<f32 const> const& distance,
+    Span<Vec2<f32> const> const& log_map)
+{
+    FILE* const file = (path) ? std::fopen(path, "w") : stdout;
+    if (file == nullptr)
+        return false;
+
+    // Write in file order
+    auto const& source_ids = mesh.vertices.source_ids;
+    auto const file_index = [&](isize const i) -> isize {
+        return (source_ids.empty()) ? i : source_ids[i];
+    };
+
+    DynamicArray<isize> order(distance.size());
+    for (isize i = 0; i < distance.size(); ++i)
+        order[file_index(i)] = i;
+
+    for (auto const i : order)
+    {
+        if (log_map.size() > 0)
+            std::fprintf(file, "%.9g %.9g %.9g\n", distance[i], log_map[i][0], log_map[i][1]);
+        else
+            std::fprintf(file, "%.9g\n", distance[i]);
+    }
+
+    return (path) ? std::fclose(file) == 0 : std::fflush(file) == 0;
+}
+
+bool write_distance_quantized(
+    char const* const path,
+    MeshAsset const& mesh,
+    Span<f32 const> const& distance)
+{
+    FILE* const file = (path) ? std::fopen(path, "wb") : stdout;
+    if (file == nullptr)
+        return false;
+
+    // Write in file order
+    auto const& source_ids = mesh.vertices.source_ids;
+    isize const num_verts = distance.size();
+
+    DynamicArray<f32> ordered(num_verts);
+    for (isize i = 0; i < num_verts; ++i)
+        ordered[(source_ids.empty()) ? i : source_ids[i]] = distance[i];
+
+    f32 max_dist = 0.0f;
+    for (auto const d : ordered)
+        max_dist = max(max_dist, d);
+
+    DynamicArray<u16> values(num_verts, 0);
+    if (max_dist > 0.0f)
+        quantize_unorm16(as_span(ordered).as_const(), max_dist, as_span(values));
+
+    bool const ok = std::fwrite(&max_dist, sizeof(f32), 1, file) == 1
+        && std::fwrite(values.data(), sizeof(u16), values.size(), file) == values.size();
+
+    return ((path) ? std::fclose(file) == 0 : std::fflush(file) == 0) && ok;
+}
+
+/// Writes a point on the surface as "<x> <y> <z> <a> <b> <c> <u> <v> <w>" where a, b and c are the
+/// vertices of its face in file order and u, v and w are its barycentric coordinates
+void write_surface_point(
+    FILE* const file,
+    MeshAsset const& mesh,
+    i32 const face,
+    Vec3<f32> const& coords)
+{
+    auto const& source_ids = mesh.vertices.source_ids;
+    auto const file_index = [&](i32 const i) -> i32 {
+        return (source_ids.empty()) ? i : source_ids[i];
+    };
+
+    auto const& positions = mesh.vertices.positions;
+    Vec3<i32> const f_v = mesh.faces.vertex_ids.col(face);
+    Vec3<f32> const p = positions.col(f_v[0]) * coords[0] + positions.col(f_v[1]) * coords[1]
+        + positions.col(f_v[2]) * coords[2];
+
+    std::fprintf(
+        file,
+        "%.9g %.9g %.9g %d %d %d %.9g %.9g %.9g\n",
+        p[0],
+        p[1],
+        p[2],
+        file_index(f_v[0]),
+        file_index(f_v[1]),
+        file_index(f_v[2]),
+        coords[0],
+        coords[1],
+        coords[2]);
+}
+
+bool write_isolines(
+    char const* const path,
+    MeshAsset const& mesh,
+    Span<f32 const> const& distance,
+    Span<f32 const> const& isovalues)
+{
+    Isolines<f32, i32> isolines{};
+    {
+        IsolineWorkspace<i32> workspace{};
+        extract_isolines(
+            as_span(mesh.faces.vertex_ids).as_const(),
+            distance,
+            isovalues,
+            isolines,
+            workspace);
+    }
+
+    FILE* const file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    for (isize i = 0; i < isolines.count(); ++i)
+    {
+        i32 const start = isolines.offsets[i];
+        i32 const end = isolines.offsets[i + 1];
+
+        std::fprintf(
+            file,
+            "%.9g %d %d\n",
+            isovalues[isolines.values[i]],
+            end - start,
+            isolines.is_closed[i]);
+
+        for (i32 j = start; j < end; ++j)
+            write_surface_point(file, mesh, isolines.point_faces[j], isolines.point_coords[j]);
+    }
+
+    return std::fclose(file) == 0;
+}
+
+bool write_paths(
+    char const* const path,
+    MeshAsset const& mesh,
+    GeodesicPathTracer<f32, i32> const& tracer,
+    Span<i32 const> const& query_vertices)
+{
+    // Trace in one batch per thread
+    isize const num_queries = query_vertices.size();
+    isize const num_threads = max<isize>(std::thread::hardware_concurrency(), 1);
+    isize const batch_size = (num_queries + num_threads - 1) / num_threads;
+
+    DynamicArray<GeodesicPaths<f32, i32>> batches(num_threads);
+    {
+        DynamicArray<std::thread> threads{};
+        for (isize i = 0; i < num_threads; ++i)
+        {
+            isize const start = min(i * batch_size, num_queries);
+            isize const count = min(batch_size, num_queries - start);
+            threads.emplace_back([&, i, start, count]() {
+                tracer.trace_vertices(query_vertices.segment(start, count), batches[i]);
+            });
+        }
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    FILE* const file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    for (auto const& paths : batches)
+    {
+        for (isize i = 0; i < paths.count(); ++i)
+        {
+            i32 const start = paths.offsets[i];
+            i32 const end = paths.offsets[i + 1];
+            std::fprintf(file, "%d %d\n", paths.reached[i], end - start);
+
+            for (i32 j = start; j < end; ++j)
+                write_surface_point(file, mesh, paths.point_faces[j], paths.point_coords[j]);
+        }
+    }
+
+    return std::fclose(file) == 0;
+}
+
+int run(Config& config)
+{
+    MeshAsset mesh{};
+    if (!read_mesh_ply(config.mesh_path, mesh))
+    {
+        std::fprintf(stderr, "Failed to read mesh \"%s\"\n", config.mesh_path);
+        return EXIT_FAILURE;
+    }
+
+    reorder_mesh(mesh);
+    isize const num_verts = mesh.vertices.count();
+
+    // Map source and path vertices from file order
+    {
+        DynamicArray<i32> vert_index(num_verts);
+        for (isize i = 0; i < num_verts; ++i)
+            vert_index[mesh.vertices.source_ids[i]] = static_cast<i32>(i);
+
+        auto const map_vertices = [&](DynamicArray<i32>& verts, char const* const name) -> bool {
+            for (auto& v : verts)
+            {
+                if (v < 0 || v >= num_verts)
+                {
+                    std::fprintf(stderr, "%s vertex %d is out of range\n", name, v);
+                    return false;
+                }
+
+                v = vert_index[v];
+            }
+
+            return true;
+        };
+
+        if (!map_vertices(config.source_vertices, "Source")
+            || !map_vertices(config.path_vertices, "Path"))
+            return EXIT_FAILURE;
+    }
+
+    auto const vert_coords = as_span(mesh.vertices.positions).as_const();
+    auto const face_verts = as_span(mesh.faces.vertex_ids).as_const();
+
+    f32 time = initial_time(vert_coords, face_verts, config.time_scale, config.time);
+
+    HeatMethod<f32, i32> solver{};
+    HeatMethod<f32, i32>::Workspace workspace{};
+    DynamicArray<f32> distance(num_verts);
+    DynamicArray<Vec2<f32>> log_map{};
+
+    if (config.log_map)
+    {
+        solver.vector_heat = true;
+        log_map.resize(num_verts);
+    }
+
+    i32 num_retries = 0;
+    bool ok = init_with_retry(solver, vert_coords, face_verts, time, num_retries);
+
+    auto const solve = [&]() -> bool {
+        if (config.log_map)
+        {
+            solver.solve_log_map(
+                config.source_vertices[0],
+                as_span(log_map),
+                as_span(distance),
+                workspace,
+                BoundaryCondition_Averaged);
+
+            return workspace.is_solved();
+        }
+
+        // NOTE(dr): Paths are traced along the distance gradient so it's kept if needed
+        solver.solve(
+            as_span(config.source_vertices).as_const(),
+            as_span(distance),
+            workspace,
+            BoundaryCondition_Averaged,
+            config.paths_path != nullptr);
+
+        return workspace.is_solved() && as_vec(as_span(distance)).allFinite();
+    };
+
+    if (ok)
+        ok = solve_with_retry(solver, time, num_retries, solve);
+
+    if (config.print_stats)
+        print_stats(mesh, solver, workspace);
+
+    if (!ok)
+    {
+        std::fprintf(stderr, "Failed to solve for distance\n");
+        return EXIT_FAILURE;
+    }
+
+    bool const write_ok = (config.quantize)
+        ? write_distance_quantized(config.output_path, mesh, as_span(distance).as_const())
+        : write_distance(
+              config.output_path,
+              mesh,
+              as_span(distance).as_const(),
+              as_span(log_map).as_const());
+
+    if (!write_ok)
+    {
+        std::fprintf(stderr, "Failed to write distance\n");
+        return EXIT_FAILURE;
+    }
+
+    if (config.isolines_path)
+    {
+        bool const isolines_ok = write_isolines(
+            config.isolines_path,
+            mesh,
+            as_span(distance).as_const(),
+            as_span(config.isovalues).as_const());
+
+        if (!isolines_ok)
+        {
+            std::fprintf(stderr, "Failed to write isolines\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (config.paths_path)
+    {
+        // NOTE(dr): The log map only solves for distance from the first source
+        auto const sources = as_span(config.source_vertices).as_const();
+
+        GeodesicPathTracer<f32, i32> tracer{};
+        tracer.init(vert_coords, face_verts);
+        tracer.set_field(
+            (config.log_map) ? sources.front(1) : sources,
+            as_span(distance).as_const(),
+            workspace.grad_distance());
+
+        bool const paths_ok = write_paths(
+            config.paths_path,
+            mesh,
+            tracer,
+            as_span(config.path_vertices).as_const());
+
+        if (!paths_ok)
+        {
+            std::fprintf(stderr, "Failed to write paths\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+} // namespace dr
+
+int main(int argc, char* argv[])
+{
+    using namespace dr;
+
+    Config config{};
+    if (!parse_args(argc, argv, config))
+    {
+        std::fprintf(
+            stderr,
+            "Usage: %s <mesh path> [-s <source vertex>]... [-t <time scale>] [--time <time>] "
+            "[-o <output path>] [-i <isovalue>]... [--isolines <output path>] "
+            "[-p <path vertex>]... [--paths <output path>] [--log-map] [--quantize] [--stats]\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return run(config);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+    Preconditioned conjugate gradients for symmetric positive (semi)definite systems given as
+    operators rather than assembled matrices
+*/
+
+#include <cmath>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/span.hpp>
+
+namespace dr
+{
+
+template <typename Real>
+struct ConjugateGradientWork
+{
+    DynamicArray<Real> r{};
+    DynamicArray<Real> z{};
+    DynamicArray<Real> p{};
+    DynamicArray<Real> q{};
+
+    void resize(isize const size)
+    {
+        r.resize(size);
+        z.resize(size);
+        p.resize(size);
+        q.resize(size);
+    }
+};
+
+/// Solves A x = b via preconditioned conjugate gradients. The given value of x is used as the
+/// initial guess. Operators are called as op(x, y) and write y = op(x). r, z, p and q are scratch
+/// storage of the same size as b. Returns the number of iterations taken or -1 if the solve didn't
+/// converge within the given limit.
+template <typename Real, typename ApplyA, typename ApplyPrecond>
+isize solve_conjugate_gradient(
+    ApplyA&& apply_A,
+    ApplyPrecond&& apply_precond,
+    Span<Real const> const& b,
+    Span<Real> const& x,
+    Span<Real> const& r,
+    Span<Real> const& z,
+    Span<Real> const& p,
+    Span<Real> const& q,
+    Real const tolerance,
+    isize const max_iterations)
+{
+    // NOTE(dr): Dot products are accumulated in double precision since convergence stalls early
+    // otherwise when Real is single precision
+    auto const dot = [](Span<Real const> const& u, Span<Real const> const& v) -> f64 {
+        return as_vec(u).template cast<f64>().dot(as_vec(v).template cast<f64>());
+    };
+
+    f64 const b_norm_sq = dot(b, b);
+    if (b_norm_sq == 0.0)
+    {
+        as_vec(x).setZero();
+        return 0;
+    }
+
+    f64 const tol_sq = b_norm_sq * f64(tolerance) * f64(tolerance);
+
+    // r = b - A x
+    apply_A(x.as_const(), r);
+    as_vec(r) = as_vec(b) - as_vec(r);
+
+    apply_precond(r.as_const(), z);
+    as_vec(p) = as_vec(z);
+    f64 rz = dot(r.as_const(), z.as_const());
+
+    for (isize k = 0; k < max_iterations; ++k)
+    {
+        if (dot(r.as_const(), r.as_const()) <= tol_sq)
+            return k;
+
+        apply_A(p.as_const(), q);
+        Real const alpha = rz / dot(p.as_const(), q.as_const());
+        as_vec(x) += alpha * as_vec(p);
+        as_vec(r) -= alpha * as_vec(q);
+
+        apply_precond(r.as_const(), z);
+        f64 const rz_next = dot(r.as_const(), z.as_const());
+        Real const beta = rz_next / rz;
+        as_vec(p) = as_vec(z) + beta * as_vec(p);
+        rz = rz_next;
+    }
+
+    return (dot(r.as_const(), r.as_const()) <= tol_sq) ? max_iterations : -1;
+}
+
+/// Solves A x = b via preconditioned conjugate gradients with scratch storage in `work`
+template <typename Real, typename ApplyA, typename ApplyPrecond>
+isize solve_conjugate_gradient(
+    ApplyA&& apply_A,
+    ApplyPrecond&& apply_precond,
+    Span<Real const> const& b,
+    Span<Real> const& x,
+    ConjugateGradientWork<Real>& work,
+    Real const tolerance,
+    isize const max_iterations)
+{
+    work.resize(b.size());
+    return solve_conjugate_gradient(
+        apply_A,
+        apply_precond,
+        b,
+        x,
+        as_span(work.r),
+        as_span(work.z),
+        as_span(work.p),
+        as_span(work.q),
+        tolerance,
+        max_iterations);
+}
+
+} // namespace dr
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+    Selection of the diffusion time t used by the heat method. The default is derived from the
+    mesh and grown if it turns out to be too small, i.e. if factorization fails or heat underflows
+    away from sources.
+*/
+
+#include <dr/basic_types.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "mesh_utils.hpp"
+
+namespace dr
+{
+
+/// Maximum number of times t is grown before giving up
+constexpr i32 max_time_retries = 4;
+
+/// Factor by which t is grown on each retry
+constexpr f32 time_growth = 4.0f;
+
+/// Returns the default diffusion time of the given mesh scaled by the given factor
+template <typename Real, typename Index>
+Real default_time(
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec3<Index> const> const& face_vertices,
+    Real const time_scale = Real{1.0})
+{
+    // NOTE(dr): Paper recommends square mean edge length as a good choice for t
+    Real const mean_edge_len = mean_edge_length(vertex_positions, face_vertices);
+    return mean_edge_len * mean_edge_len * time_scale;
+}
+
+/// Returns the given time if it's positive and the default time of the given mesh scaled by the
+/// given factor otherwise
+template <typename Real, typename Index>
+Real initial_time(
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec3<Index> const> const& face_vertices,
+    Real const time_scale,
+    Real const time)
+{
+    return (time > Real{0.0}) ? time : default_time(vertex_positions, face_vertices, time_scale);
+}
+
+/// Grows t until the heat operator of the given solver refactors successfully. Returns false once
+/// retries are exhausted. `num_retries` is shared between calls so that a single budget covers
+/// both initialization and solving.
+template <typename Solver, typename Real>
+bool grow_time(Solver& solver, Real& time, i32& num_retries)
+{
+    while (num_retries < max_time_retries)
+    {
+        ++num_retries;
+        if (solver.reinit(time *= time_growth))
+            return true;
+    }
+
+    return false;
+}
+
+/// Initializes the given solver, growing t if the heat operator fails to factor
+template <typename Solver, typename Real, typename Index>
+bool init_with_retry(
+    Solver& solver,
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec3<Index> const> const& face_vertices,
+    Real& time,
+    i32& num_retries)
+{
+    // NOTE(dr): Only refactor the heat operator if the mesh was otherwise assembled successfully
+    return solver.init(vertex_positions, face_vertices, time)
+        || (solver.is_assembled() && grow_time(solver, time, num_retries));
+}
+
+/// Calls `solve` until it returns true, growing t after each failure
+template <typename Solver, typename Real, typename Solve>
+bool solve_with_retry(Solver& solver, Real& time, i32& num_retries, Solve&& solve)
+{
+    while (!solve())
+    {
+        if (!grow_time(solver, time, num_retries))
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace dr
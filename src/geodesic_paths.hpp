@@ -0,0 +1,368 @@
+#pragma once
+
+/*
+    Tracing of geodesic paths by integrating backwards along the per-face distance gradient from
+    the heat method (see HeatMethod::solve with store_grads). Paths are returned as polylines whose
+    points are located by face and barycentric coordinates as with isolines.
+*/
+
+#include <cassert>
+#include <limits>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/math.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "mesh_utils.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct GeodesicPaths
+{
+    DynamicArray<Index> point_faces{}; // Face containing each point
+    DynamicArray<Vec3<Real>> point_coords{}; // Barycentric coordinates of each point in its face
+    DynamicArray<Index> offsets{}; // Start of each path followed by the total number of points
+    DynamicArray<u8> reached{}; // Whether each path ended at a source vertex
+
+    isize count() const { return size(reached); }
+
+    isize num_points() const { return size(point_faces); }
+
+    void clear()
+    {
+        point_faces.clear();
+        point_coords.clear();
+        offsets.clear();
+        reached.clear();
+    }
+};
+
+template <typename Real, typename Index>
+struct GeodesicPathTracer
+{
+    /// Maximum number of steps (i.e. face or edge crossings) taken by a single path
+    isize max_steps{1 << 16};
+
+    /// Precomputes connectivity and per-face geometry of the given mesh
+    void init(
+        Span<Vec3<Real> const> const& vertex_positions,
+        Span<Vec3<Index> const> const& face_vertices)
+    {
+        isize const num_verts = vertex_positions.size();
+        isize const num_faces = face_vertices.size();
+
+        face_verts_.assign(face_vertices.begin(), face_vertices.end());
+        collect_vertex_faces(face_vertices, num_verts, vert_face_offsets_, vert_faces_);
+
+        DynamicArray<Vec3<Index>> neighbors{};
+        collect_face_neighbors(face_vertices, neighbors);
+
+        // NOTE(dr): Everything needed to step across a face is kept together so each step touches
+        // a single element
+        faces_.resize(num_faces);
+        for (isize f = 0; f < num_faces; ++f)
+        {
+            auto const& f_v = face_vertices[f];
+            Vec3<Real> const p[]{
+                vertex_positions[f_v[0]],
+                vertex_positions[f_v[1]],
+                vertex_positions[f_v[2]],
+            };
+
+            // Gradient of each barycentric coordinate
+            Vec3<Real> const n = (p[1] - p[0]).cross(p[2] - p[0]);
+            Real const n_sqr = n.squaredNorm();
+
+            Face& face = faces_[f];
+            for (int i = 0; i < 3; ++i)
+            {
+                face.bary_grads.col(i) = (n_sqr > Real{0.0})
+                    ? (n.cross(p[(i + 2) % 3] - p[(i + 1) % 3]) / n_sqr).eval()
+                    : Vec3<Real>::Zero();
+            }
+
+            face.neighbors = neighbors[f];
+        }
+
+        positions_.assign(vertex_positions.begin(), vertex_positions.end());
+        is_source_.assign(num_verts, 0);
+    }
+
+    /// Sets the field to trace paths through. `grad_distance` is the per-face distance gradient
+    /// from a solve with store_grads and `distance` is the corresponding solution. Both must
+    /// outlive any calls to trace.
+    void set_field(
+        Span<Index const> const& source_vertices,
+        Span<Real const> const& distance,
+        Span<Covec3<Real> const> const& grad_distance)
+    {
+        assert(distance.size() == dr::size(is_source_));
+        assert(grad_distance.size() == dr::size(faces_));
+
+        std::fill(is_source_.begin(), is_source_.end(), 0);
+        for (auto const v : source_vertices)
+            is_source_[v] = 1;
+
+        distance_ = distance;
+        grad_dist_ = grad_distance;
+    }
+
+    /// Traces a path from each query point (given by face and barycentric coordinates) to the
+    /// nearest source. Safe to call concurrently from multiple threads with separate results so
+    /// large batches can be split up by the caller.
+    void trace(
+        Span<Index const> const& query_faces,
+        Span<Vec3<Real> const> const& query_coords,
+        GeodesicPaths<Real, Index>& result) const
+    {
+        assert(query_faces.size() == query_coords.size());
+        result.clear();
+
+        for (isize i = 0; i < query_faces.size(); ++i)
+        {
+            result.offsets.push_back(Index(result.num_points()));
+            result.reached.push_back(trace_path(query_faces[i], query_coords[i], result));
+        }
+
+        result.offsets.push_back(Index(result.num_points()));
+    }
+
+    /// Traces a path from each query vertex to the nearest source
+    void trace_vertices(
+        Span<Index const> const& query_vertices,
+        GeodesicPaths<Real, Index>& result) const
+    {
+        result.clear();
+
+        for (auto const v : query_vertices)
+        {
+            result.offsets.push_back(Index(result.num_points()));
+
+            // Start from any incident face
+            bool reached = false;
+            if (vert_face_offsets_[v] != vert_face_offsets_[v + 1])
+            {
+                Index const f = vert_faces_[vert_face_offsets_[v]];
+                reached = trace_path(f, unit_coords(local_index(f, v)), result);
+            }
+
+            result.reached.push_back(reached);
+        }
+
+        result.offsets.push_back(Index(result.num_points()));
+    }
+
+    bool is_init() const { return dr::size(faces_) > 0; }
+
+  private:
+    struct Face
+    {
+        Mat3<Real> bary_grads; // Gradient of each barycentric coordinate as columns
+        Vec3<Index> neighbors; // Neighbor across each edge as from collect_face_neighbors
+    };
+
+    static constexpr Real eps{1.0e-5}; // Tolerance on barycentric coordinates
+
+    DynamicArray<Face> faces_{};
+    DynamicArray<Vec3<Index>> face_verts_{};
+    DynamicArray<Vec3<Real>> positions_{};
+    DynamicArray<Index> vert_face_offsets_{};
+    DynamicArray<Index> vert_faces_{};
+    DynamicArray<u8> is_source_{};
+    Span<Real const> distance_{};
+    Span<Covec3<Real> const> grad_dist_{};
+
+    static Vec3<Real> unit_coords(int const i)
+    {
+        Vec3<Real> result = Vec3<Real>::Zero();
+        result[i] = Real{1.0};
+        return result;
+    }
+
+    int local_index(Index const f, Index const v) const
+    {
+        auto const& f_v = face_verts_[f];
+        return (f_v[0] == v) ? 0 : (f_v[1] == v) ? 1 : 2;
+    }
+
+    /// Returns the rate of change of barycentric coordinates along the path in the given face
+    Vec3<Real> coords_velocity(Index const f) const
+    {
+        return faces_[f].bary_grads.transpose() * -grad_dist_[f].transpose();
+    }
+
+    /// Traces a single path and appends its points to the result. Returns true if the path reached
+    /// a source vertex.
+    bool trace_path(Index f, Vec3<Real> b, GeodesicPaths<Real, Index>& result) const
+    {
+        auto const push_point = [&](Index const face, Vec3<Real> const& coords) {
+            result.point_faces.push_back(face);
+            result.point_coords.push_back(coords);
+        };
+
+        push_point(f, b);
+
+        for (isize step = 0; step < max_steps; ++step)
+        {
+            auto const& f_v = face_verts_[f];
+
+            // Finish with a straight segment if the current face has a source vertex
+            for (int i = 0; i < 3; ++i)
+            {
+                if (is_source_[f_v[i]])
+                {
+                    if (b[i] < Real{1.0} - eps)
+                        push_point(f, unit_coords(i));
+
+                    return true;
+                }
+            }
+
+            // Find where the path leaves the face
+            Vec3<Real> const db = coords_velocity(f);
+            Real t = std::numeric_limits<Real>::infinity();
+            int exit = -1;
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (db[i] < Real{0.0})
+                {
+                    Real const t_i = max(-b[i] / db[i], Real{0.0});
+                    if (t_i < t)
+                    {
+                        t = t_i;
+                        exit = i;
+                    }
+                }
+            }
+
+            // Gradient vanishes (e.g. on a degenerate face)
+            if (exit < 0)
+                return false;
+
+            if (t > Real{0.0})
+            {
+                b += t * db;
+                b[exit] = Real{0.0};
+                b = b.cwiseMax(Real{0.0});
+                b /= b.sum();
+                push_point(f, b);
+            }
+
+            // Continue from a vertex if the path ran into one
+            {
+                int i;
+                if (b.maxCoeff(&i) >= Real{1.0} - eps)
+                {
+                    if (!step_from_vertex(f_v[i], f, b, push_point))
+                        return false;
+
+                    continue;
+                }
+            }
+
+            // Cross the exit edge (opposite the exit vertex) if the neighboring face leads away
+            // from it
+            int const e0 = (exit + 1) % 3;
+            int const e1 = (exit + 2) % 3;
+            Index const g = faces_[f].neighbors[e0];
+
+            if (g >= 0)
+            {
+                int const g0 = local_index(g, f_v[e0]);
+                int const g1 = local_index(g, f_v[e1]);
+                int const g2 = 3 - g0 - g1;
+
+                if (coords_velocity(g)[g2] > Real{0.0})
+                {
+                    Vec3<Real> b_g{};
+                    b_g[g0] = b[e0];
+                    b_g[g1] = b[e1];
+                    b_g[g2] = Real{0.0};
+
+                    f = g;
+                    b = b_g;
+                    continue;
+                }
+            }
+
+            // Otherwise the path is pushed against the edge from both sides (or it's a boundary
+            // edge) so follow the edge to whichever end the gradients lead towards
+            {
+                Vec3<Real> const d = positions_[f_v[e1]] - positions_[f_v[e0]];
+                Real rate = -grad_dist_[f].dot(d);
+
+                if (g >= 0)
+                    rate -= grad_dist_[g].dot(d);
+
+                int const i = (rate > Real{0.0}) ? e1 : e0;
+                b = unit_coords(i);
+                push_point(f, b);
+
+                if (!step_from_vertex(f_v[i], f, b, push_point))
+                    return false;
+            }
+        }
+
+        return false;
+    }
+
+    /// Finds how to leave the given vertex. This is either into an incident face whose gradient
+    /// points into it from the vertex or, failing that, along the edge to the neighboring vertex
+    /// with the least distance. Updates the current face and coordinates accordingly. Returns
+    /// false if the vertex is a local minimum of distance.
+    template <typename PushPoint>
+    bool step_from_vertex(Index const v, Index& f, Vec3<Real>& b, PushPoint&& push_point) const
+    {
+        Index const start = vert_face_offsets_[v];
+        Index const end = vert_face_offsets_[v + 1];
+
+        for (Index j = start; j < end; ++j)
+        {
+            Index const h = vert_faces_[j];
+            int const i = local_index(h, v);
+            Vec3<Real> const db = coords_velocity(h);
+
+            if (db[i] < Real{0.0} && db[(i + 1) % 3] >= Real{0.0} && db[(i + 2) % 3] >= Real{0.0})
+            {
+                f = h;
+                b = unit_coords(i);
+                return true;
+            }
+        }
+
+        // Step along the edge of steepest descent
+        Real min_dist = distance_[v];
+        Index min_face = -1;
+        int min_index = -1;
+
+        for (Index j = start; j < end; ++j)
+        {
+            Index const h = vert_faces_[j];
+            auto const& h_v = face_verts_[h];
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (distance_[h_v[i]] < min_dist)
+                {
+                    min_dist = distance_[h_v[i]];
+                    min_face = h;
+                    min_index = i;
+                }
+            }
+        }
+
+        if (min_face < 0)
+            return false;
+
+        f = min_face;
+        b = unit_coords(min_index);
+        push_point(f, b);
+        return true;
+    }
+};
+
+} // namespace dr
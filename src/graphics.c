@@ -34,21 +34,25 @@ sg_shader_desc contour_color_shader_desc(char const* const vs_src, char const* c
     // clang-format on
 }
 
-sg_pipeline_desc contour_color_pipeline_desc(sg_shader const shader)
+sg_pipeline_desc contour_color_pipeline_desc(
+    sg_shader const shader,
+    sg_index_type const index_type)
 {
     // clang-format off
     return (sg_pipeline_desc) {
         .shader = shader,
         .layout = {
+            // Interleaved position and octahedral normal
             .attrs[0] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_FLOAT3},
-            .attrs[1] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT3},
-            .attrs[2] = {.buffer_index = 2, .format = SG_VERTEXFORMAT_FLOAT},
+            .attrs[1] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_SHORT2N},
+            // Scalar
+            .attrs[2] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT},
         },
         .depth = {
             .compare = SG_COMPAREFUNC_LESS,
             .write_enabled = true,
         },
-        .index_type = SG_INDEXTYPE_UINT32,
+        .index_type = index_type,
         .face_winding = SG_FACEWINDING_CCW,
     };
     // clang-format on
@@ -79,15 +83,19 @@ sg_shader_desc contour_line_shader_desc(char const* const vs_src, char const* co
     // clang-format on
 }
 
-sg_pipeline_desc contour_line_pipeline_desc(sg_shader const shader)
+sg_pipeline_desc contour_line_pipeline_desc(
+    sg_shader const shader,
+    sg_index_type const index_type)
 {
     // clang-format off
     return (sg_pipeline_desc) {
         .shader = shader,
         .layout = {
+            // Interleaved position and octahedral normal
             .attrs[0] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_FLOAT3},
-            .attrs[1] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT3},
-            .attrs[2] = {.buffer_index = 2, .format = SG_VERTEXFORMAT_FLOAT},
+            .attrs[1] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_SHORT2N},
+            // Scalar
+            .attrs[2] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT},
         },
         .depth = {
             .compare = SG_COMPAREFUNC_ALWAYS,
@@ -100,7 +108,7 @@ sg_pipeline_desc contour_line_pipeline_desc(sg_shader const shader)
                 .dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
             },
         },
-        .index_type = SG_INDEXTYPE_UINT32,
+        .index_type = index_type,
         .face_winding = SG_FACEWINDING_CCW,
     };
     // clang-format on
@@ -1,9 +1,15 @@
 #include "graphics.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <dr/math.hpp>
 
 #include "assets.hpp"
 #include "graphics.h"
+#include "profile.hpp"
 
 namespace dr
 {
@@ -14,11 +20,11 @@ namespace
 struct {
     struct {
         struct {
-            GfxPipeline pipeline;
+            GfxPipeline pipelines[_IndexType_Count];
             GfxShader shader;
         } contour_color;
         struct {
-            GfxPipeline pipeline;
+            GfxPipeline pipelines[_IndexType_Count];
             GfxShader shader;
         } contour_line;
     } materials;
@@ -70,6 +76,17 @@ void init_shader<ContourLine>()
     mat.shader.init(contour_line_shader_desc(vert->src.c_str(), frag->src.c_str()));
 }
 
+sg_index_type to_sg_index_type(IndexType const type)
+{
+    constexpr sg_index_type types[]{
+        SG_INDEXTYPE_UINT32,
+        SG_INDEXTYPE_UINT16,
+    };
+    static_assert(size(types) == _IndexType_Count);
+    return types[type];
+}
+
+// NOTE(dr): Index type is fixed per pipeline so each material has one for each type
 template <typename Material>
 void init_material();
 
@@ -77,20 +94,28 @@ template <>
 void init_material<ContourColor>()
 {
     auto& mat = state.materials.contour_color;
-    assert(!mat.pipeline.is_valid());
-
     init_shader<ContourColor>();
-    mat.pipeline = GfxPipeline::make(contour_color_pipeline_desc(mat.shader));
+
+    for (u8 i = 0; i < _IndexType_Count; ++i)
+    {
+        assert(!mat.pipelines[i].is_valid());
+        sg_index_type const index_type = to_sg_index_type(IndexType{i});
+        mat.pipelines[i] = GfxPipeline::make(contour_color_pipeline_desc(mat.shader, index_type));
+    }
 }
 
 template <>
 void init_material<ContourLine>()
 {
     auto& mat = state.materials.contour_line;
-    assert(!mat.pipeline.is_valid());
-
     init_shader<ContourLine>();
-    mat.pipeline = GfxPipeline::make(contour_line_pipeline_desc(mat.shader));
+
+    for (u8 i = 0; i < _IndexType_Count; ++i)
+    {
+        assert(!mat.pipelines[i].is_valid());
+        sg_index_type const index_type = to_sg_index_type(IndexType{i});
+        mat.pipelines[i] = GfxPipeline::make(contour_line_pipeline_desc(mat.shader, index_type));
+    }
 }
 
 template <typename T>
@@ -107,6 +132,49 @@ void update_buffer(GfxBuffer& buf, GfxBuffer::Desc const& desc)
         buf = GfxBuffer::make(desc);
 }
 
+/// Interleaved vertex attributes. Matches the layout in each material's pipeline desc.
+struct RenderVertex
+{
+    Vec3<f32> position;
+    i16 normal[2]; // Octahedral encoding
+};
+static_assert(sizeof(RenderVertex) == 16);
+
+/// Maps a unit vector to the octahedron unfolded onto the unit square and quantizes the result to
+/// normalized 16-bit integers
+void encode_octahedral(Vec3<f32> const& n, i16 result[2])
+{
+    f32 const l1 = std::abs(n.x()) + std::abs(n.y()) + std::abs(n.z());
+    if (l1 == 0.0f)
+    {
+        result[0] = result[1] = 0;
+        return;
+    }
+
+    f32 const inv_l1 = 1.0f / l1;
+    f32 x = n.x() * inv_l1;
+    f32 y = n.y() * inv_l1;
+
+    // Fold the lower hemisphere over the diagonals
+    if (n.z() < 0.0f)
+    {
+        f32 const x_fold = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        f32 const y_fold = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = x_fold;
+        y = y_fold;
+    }
+
+    result[0] = static_cast<i16>(std::lround(clamp(x, -1.0f, 1.0f) * 32767.0f));
+    result[1] = static_cast<i16>(std::lround(clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+/// Returns the capacity needed to hold the given count. Capacity grows geometrically so that
+/// buffers aren't recreated each time a slightly larger mesh is loaded.
+isize grow_capacity(isize const capacity, isize const count)
+{
+    return (count > capacity) ? max(count, capacity + capacity / 2) : capacity;
+}
+
 template <typename Material>
 void apply_uniforms(Material&& mat)
 {
@@ -147,11 +215,18 @@ void reload_shaders()
 
 void RenderMesh::set_vertex_capacity(isize const value)
 {
-    update_buffer(vertices[0], vertex_buffer_desc(value * sizeof(f32[6])));
-    update_buffer(vertices[1], vertex_buffer_desc(value * sizeof(f32)));
+    update_buffer(vertices, vertex_buffer_desc(value * sizeof(RenderVertex)));
     vertex_capacity = value;
 }
 
+void RenderMesh::set_scalar_capacity(isize const value)
+{
+    for (auto& buf : scalar_buffers)
+        update_buffer(buf, vertex_buffer_desc(value * sizeof(f32)));
+
+    scalar_capacity = value;
+}
+
 void RenderMesh::set_index_capacity(isize const value)
 {
     update_buffer(indices, index_buffer_desc(value * sizeof(i32)));
@@ -163,46 +238,142 @@ void RenderMesh::set_vertices(
     Span<Vec3<f32> const> const& normals)
 {
     assert(positions.size() == normals.size());
+    ProfileScope const scope{ProfileZone_UploadVertices};
 
+    DynamicArray<RenderVertex> data(positions.size());
+    for (isize i = 0; i < positions.size(); ++i)
+    {
+        data[i].position = positions[i];
+        encode_octahedral(normals[i], data[i].normal);
+    }
+
+    // NOTE(dr): Appends within a frame are placed after one another so the offset of this one is
+    // kept for binding. A new buffer is made if it doesn't have room left in the current frame.
+    sg_range const range = to_range(as_span(data));
     vertex_count = positions.size();
-    if (vertex_count > vertex_capacity)
-        set_vertex_capacity(vertex_count);
 
-    sg_append_buffer(vertices[0], to_range(positions));
-    sg_append_buffer(vertices[0], to_range(normals));
+    if (vertex_count > vertex_capacity || sg_query_buffer_will_overflow(vertices, range.size))
+        set_vertex_capacity(grow_capacity(vertex_capacity, vertex_count));
+
+    vertex_offset = sg_append_buffer(vertices, range);
+    profile_count(ProfileCounter_UploadBytes, range.size);
 }
 
 void RenderMesh::set_vertices(Span<f32 const> const& scalars)
 {
+    ProfileScope const scope{ProfileZone_UploadVertices};
+
     vertex_count = scalars.size();
-    if (vertex_count > vertex_capacity)
-        set_vertex_capacity(vertex_count);
+    if (vertex_count > scalar_capacity)
+        set_scalar_capacity(grow_capacity(scalar_capacity, vertex_count));
 
-    sg_update_buffer(vertices[1], to_range(scalars));
+    // Previous changes are overwritten
+    std::fill(std::begin(scalar_stale_ends), std::end(scalar_stale_ends), 0);
+
+    scalar_values.assign(scalars.begin(), scalars.end());
+    upload_scalars(vertex_count);
 }
 
-void RenderMesh::set_indices(Span<Vec3<i32> const> const& faces)
+void RenderMesh::update_vertices(Span<f32 const> const& scalars, isize const offset)
 {
-    index_count = faces.size() * 3;
+    assert(offset >= 0 && offset + scalars.size() <= size(scalar_values));
+    ProfileScope const scope{ProfileZone_UploadVertices};
+
+    std::copy(scalars.begin(), scalars.end(), scalar_values.begin() + offset);
+    upload_scalars(offset + scalars.size());
+}
+
+void RenderMesh::upload_scalars(isize const end)
+{
+    // Every buffer is now outdated up to the end of the changed range
+    for (auto& stale_end : scalar_stale_ends)
+        stale_end = max(stale_end, end);
+
+    // NOTE(dr): Sokol only updates buffers from the start so the uploaded range also includes
+    // everything before the changed range, along with any changes this buffer missed while others
+    // in the ring were written. Vertices are ordered for locality (see reorder_mesh) which keeps
+    // localized changes from spanning the whole range.
+    scalar_index = (scalar_index + 1) % num_scalar_buffers;
+    isize& stale_end = scalar_stale_ends[scalar_index];
+
+    auto const values = as_span(scalar_values).front(stale_end);
+    sg_update_buffer(scalar_buffers[scalar_index], to_range(values));
+    profile_count(ProfileCounter_UploadBytes, values.size() * sizeof(f32));
+
+    stale_end = 0;
+}
+
+void RenderMesh::set_indices(
+    Span<Vec3<i32> const> const& faces,
+    Span<Vec3<i32> const> const& lod_faces,
+    Span<i32 const> const& lod_offsets)
+{
+    ProfileScope const scope{ProfileZone_UploadIndices};
+
+    index_offsets.assign(1, 0);
+    index_offsets.push_back(static_cast<i32>(faces.size() * 3));
+
+    for (isize i = 1; i < lod_offsets.size(); ++i)
+        index_offsets.push_back(index_offsets[1] + lod_offsets[i] * 3);
+
+    index_count = index_offsets.back();
     if (index_count > index_capacity)
-        set_index_capacity(index_count);
+        set_index_capacity(grow_capacity(index_capacity, index_count));
 
-    sg_update_buffer(indices, to_range(faces));
+    // Use 16-bit indices if the largest index fits (coarser levels index a subset of vertices)
+    i32 max_index = 0;
+    for (auto const& f_v : faces)
+        max_index = max(max_index, f_v.maxCoeff());
+
+    // NOTE(dr): WebGL2 always treats the largest index as a primitive restart so it's excluded
+    index_type = (max_index < i32(std::numeric_limits<u16>::max())) //
+        ? IndexType_U16
+        : IndexType_U32;
+
+    // Levels of detail follow the full mesh in a single upload
+    sg_range range = to_range(faces);
+    DynamicArray<Vec3<i32>> data{};
+    DynamicArray<Vec3<u16>> data_u16{};
+
+    if (index_type == IndexType_U16)
+    {
+        data_u16.reserve(faces.size() + lod_faces.size());
+
+        for (auto const& f_v : faces)
+            data_u16.push_back(f_v.cast<u16>());
+
+        for (auto const& f_v : lod_faces)
+            data_u16.push_back(f_v.cast<u16>());
+
+        range = to_range(as_span(data_u16));
+    }
+    else if (lod_faces.size() > 0)
+    {
+        data.reserve(faces.size() + lod_faces.size());
+        data.insert(data.end(), faces.begin(), faces.end());
+        data.insert(data.end(), lod_faces.begin(), lod_faces.end());
+        range = to_range(as_span(data));
+    }
+
+    sg_update_buffer(indices, range);
+    profile_count(ProfileCounter_UploadBytes, range.size);
 }
 
 void RenderMesh::bind_resources(sg_bindings& dst) const
 {
-    dst.vertex_buffers[0] = vertices[0];
-    dst.vertex_buffers[1] = vertices[0];
-    dst.vertex_buffer_offsets[1] = vertex_count * sizeof(f32[3]);
-    dst.vertex_buffers[2] = vertices[1];
+    dst.vertex_buffers[0] = vertices;
+    dst.vertex_buffer_offsets[0] = vertex_offset;
+    dst.vertex_buffers[1] = scalar_buffers[scalar_index];
     dst.index_buffer = indices;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // ContourColor
 
-GfxPipeline::Handle ContourColor::pipeline() { return state.materials.contour_color.pipeline; }
+GfxPipeline::Handle ContourColor::pipeline(IndexType const index_type)
+{
+    return state.materials.contour_color.pipelines[index_type];
+}
 
 void ContourColor::bind_resources(sg_bindings& dst) const
 {
@@ -215,7 +386,10 @@ void ContourColor::apply_uniforms() const { dr::apply_uniforms(*this); }
 ////////////////////////////////////////////////////////////////////////////////
 // ContourLine
 
-GfxPipeline::Handle ContourLine::pipeline() { return state.materials.contour_line.pipeline; }
+GfxPipeline::Handle ContourLine::pipeline(IndexType const index_type)
+{
+    return state.materials.contour_line.pipelines[index_type];
+}
 
 void ContourLine::bind_resources(sg_bindings& /*dst*/) const {}
 
@@ -10,11 +10,11 @@ extern "C"
 
 sg_shader_desc contour_color_shader_desc(char const* vs_src, char const* fs_src);
 
-sg_pipeline_desc contour_color_pipeline_desc(sg_shader shader);
+sg_pipeline_desc contour_color_pipeline_desc(sg_shader shader, sg_index_type index_type);
 
 sg_shader_desc contour_line_shader_desc(char const* vs_src, char const* fs_src);
 
-sg_pipeline_desc contour_line_pipeline_desc(sg_shader shader);
+sg_pipeline_desc contour_line_pipeline_desc(sg_shader shader, sg_index_type index_type);
 
 sg_buffer_desc vertex_buffer_desc(size_t size);
 
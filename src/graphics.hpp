@@ -1,6 +1,7 @@
 #pragma once
 
 #include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
 #include <dr/math_types.hpp>
 #include <dr/span.hpp>
 
@@ -16,26 +17,72 @@ void reload_shaders();
 ////////////////////////////////////////////////////////////////////////////////
 // Geometry
 
+enum IndexType : u8
+{
+    IndexType_U32 = 0,
+    IndexType_U16, // Used when all vertex indices fit which halves the size of the index buffer
+    _IndexType_Count,
+};
+
 struct RenderMesh
 {
-    GfxBuffer vertices[2];
+    // NOTE(dr): Scalars are streamed through a ring of buffers so that an upload never writes to
+    // the buffer drawn in the previous frame(s)
+    static constexpr isize num_scalar_buffers{3};
+
+    GfxBuffer vertices{}; // Interleaved positions and normals
     isize vertex_capacity{};
     isize vertex_count{};
+    i32 vertex_offset{}; // Offset of the most recent upload in bytes
+
+    GfxBuffer scalar_buffers[num_scalar_buffers];
+    DynamicArray<f32> scalar_values{}; // CPU copy of the most recent scalars
+    isize scalar_stale_ends[num_scalar_buffers]{}; // End of the outdated range in each buffer
+    isize scalar_capacity{};
+    isize scalar_index{}; // Buffer holding the most recent scalars
 
     GfxBuffer indices{};
-    isize index_capacity{};
+    isize index_capacity{}; // In 32-bit indices
     isize index_count{};
+    IndexType index_type{};
+    DynamicArray<i32> index_offsets{}; // Start of each level of detail followed by index_count
 
     void set_vertices(Span<Vec3<f32> const> const& positions, Span<Vec3<f32> const> const& normals);
     void set_vertices(Span<f32 const> const& scalars);
-    void set_indices(Span<Vec3<i32> const> const& faces);
+
+    /// Updates the scalars of a contiguous range of vertices starting at the given offset
+    void update_vertices(Span<f32 const> const& scalars, isize offset);
+
+    /// Sets the faces to draw at full detail along with those of any coarser levels.
+    /// `lod_offsets` holds the start of each coarser level in `lod_faces` followed by their total.
+    /// Indices are uploaded as 16-bit if all faces allow it in which case materials must be drawn
+    /// with the matching pipeline.
+    void set_indices(
+        Span<Vec3<i32> const> const& faces,
+        Span<Vec3<i32> const> const& lod_faces = {},
+        Span<i32 const> const& lod_offsets = {});
+
+    isize num_lods() const { return size(index_offsets) - 1; }
 
     void bind_resources(sg_bindings& dst) const;
-    void dispatch_draw() const { sg_draw(0, index_count, 1); };
+
+    /// Draws the given level of detail (0 is full detail)
+    void dispatch_draw(isize const lod = 0) const
+    {
+        sg_draw(index_offsets[lod], index_offsets[lod + 1] - index_offsets[lod], 1);
+    };
+
+    /// Draws a range of faces at full detail
+    void dispatch_draw_faces(isize const start, isize const count) const
+    {
+        sg_draw(start * 3, count * 3, 1);
+    };
 
   private:
     void set_vertex_capacity(isize value);
+    void set_scalar_capacity(isize value);
     void set_index_capacity(isize value);
+    void upload_scalars(isize end);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -58,7 +105,7 @@ struct ContourColor
         } fragment;
     } uniforms{};
 
-    static GfxPipeline::Handle pipeline();
+    static GfxPipeline::Handle pipeline(IndexType index_type);
     void bind_resources(sg_bindings& dst) const;
     void apply_uniforms() const;
 };
@@ -81,7 +128,7 @@ struct ContourLine
         } fragment;
     } uniforms{};
 
-    static GfxPipeline::Handle pipeline();
+    static GfxPipeline::Handle pipeline(IndexType index_type);
     void bind_resources(sg_bindings& dst) const;
     void apply_uniforms() const;
 };
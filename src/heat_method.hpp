@@ -6,28 +6,236 @@
 
     Refs
     https://www.cs.cmu.edu/~kmcrane/Projects/HeatMethod/paperCACM.pdf
+    https://www.cs.cmu.edu/~kmcrane/Projects/VectorHeatMethod/paper.pdf
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <iterator>
+#include <utility>
 
-#include <Eigen/SparseCholesky>
+#include <Eigen/Cholesky>
 
 #include <dr/dynamic_array.hpp>
 #include <dr/geometry.hpp>
 #include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
 #include <dr/math_types.hpp>
 #include <dr/mesh_attributes.hpp>
 #include <dr/mesh_operators.hpp>
 #include <dr/span.hpp>
 #include <dr/sparse_linalg_types.hpp>
 
+#include "conjugate_gradient.hpp"
+#include "memory_stats.hpp"
+#include "mesh_utils.hpp"
+#include "solver_profile.hpp"
+#include "sparse_ldlt.hpp"
+
 namespace dr
 {
 
+/// Boundary conditions used for the heat flow step on meshes with boundary. The paper recommends
+/// averaging the Neumann and Dirichlet solutions.
+enum BoundaryCondition : u8
+{
+    BoundaryCondition_Neumann = 0,
+    BoundaryCondition_Dirichlet,
+    BoundaryCondition_Averaged,
+    _BoundaryCondition_Count,
+};
+
+/// Memory use of a heat method solver
+struct HeatMethodStats
+{
+    isize nnz_stiffness; // S
+    isize nnz_heat; // A = M - t S
+    isize nnz_heat_dirichlet; // A with Dirichlet conditions
+    isize nnz_heat_factor; // Strictly lower part of L for each factorization
+    isize nnz_heat_dirichlet_factor;
+    isize nnz_distance_factor;
+    usize matrix_bytes;
+    usize factor_bytes;
+    usize buffer_bytes;
+
+    usize total_bytes() const { return matrix_bytes + factor_bytes + buffer_bytes; }
+};
+
+/// Evaluates the divergence of the approximate distance gradient (i.e. the reversed and normalized
+/// temperature gradient) without storing per-face gradients
 template <typename Real, typename Index>
+void eval_divergence_distance_gradient(
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec3<Index> const> const& face_vertices,
+    Span<Real const> const& temperature,
+    Span<Real> const& result)
+{
+    auto const& vert_coords = vertex_positions;
+    auto const& ut = temperature;
+    auto const& lap_dist = result;
+
+    as_vec(lap_dist).setZero();
+
+    for (isize f = 0; f < face_vertices.size(); ++f)
+    {
+        auto const& f_v = face_vertices[f];
+
+        Covec3<Real> const f_grad_ut = eval_gradient(
+            vert_coords[f_v[0]],
+            vert_coords[f_v[1]],
+            vert_coords[f_v[2]],
+            ut[f_v[0]],
+            ut[f_v[1]],
+            ut[f_v[2]]);
+
+        Covec3<Real> const f_grad_dist = f_grad_ut / -f_grad_ut.norm();
+        auto const f_lap_dist = eval_divergence(
+            vert_coords[f_v[0]],
+            vert_coords[f_v[1]],
+            vert_coords[f_v[2]],
+            f_grad_dist.transpose().eval());
+
+        lap_dist[f_v[0]] += f_lap_dist[0];
+        lap_dist[f_v[1]] += f_lap_dist[1];
+        lap_dist[f_v[2]] += f_lap_dist[2];
+    }
+}
+
+/// Heat method with assembled operators. Linear systems are solved with sparse factorization by
+/// default but any solver with the interface of SparseLDLT can be used instead (e.g. SparseAMG).
+template <typename Real, typename Index, typename LinearSolver = SparseLDLT<Real, Index>>
 struct HeatMethod
 {
-    using Solver = Eigen::SimplicialLDLT<SparseMat<Real>>;
+    using Solver = LinearSolver;
+
+    /// Scratch memory and intermediate results of a single query. HeatMethod itself isn't modified
+    /// by queries so it can be shared between threads as long as each has its own workspace.
+    struct Workspace
+    {
+        bool is_solved() const { return is_solved_; }
+
+        Span<Real const> temperature() const
+        {
+            assert(is_solved());
+            return as_span(ut_);
+        }
+
+        Span<Covec3<Real> const> grad_temperature() const
+        {
+            assert(is_solved());
+            return as_span(grad_ut_);
+        }
+
+        Span<Covec3<Real> const> grad_distance() const
+        {
+            assert(is_solved());
+            return as_span(grad_dist_);
+        }
+
+        Span<Real const> lap_distance() const
+        {
+            assert(is_solved());
+            return as_span(lap_dist_);
+        }
+
+        /// Result of the last vector heat flow as coordinates in the tangent basis of each vertex
+        Span<Vec2<Real> const> vector_temperature() const
+        {
+            return as<Vec2<Real> const>(as_span(yt_));
+        }
+
+        /// Returns the number of bytes allocated by the workspace
+        usize memory_bytes() const
+        {
+            return dr::memory_bytes(u0_) + dr::memory_bytes(ut_) + dr::memory_bytes(ut_dir_)
+                + dr::memory_bytes(grad_ut_) + dr::memory_bytes(grad_dist_)
+                + dr::memory_bytes(lap_dist_) + dr::memory_bytes(work_) + dr::memory_bytes(du_)
+                + dr::memory_bytes(du_dir_) + dr::memory_bytes(sources_)
+                + dr::memory_bytes(next_sources_) + dr::memory_bytes(added_)
+                + dr::memory_bytes(bnd_sources_) + dr::memory_bytes(bnd_rhs_)
+                + dr::memory_bytes(bnd_heat_) + dr::memory_bytes(schur_) + dr::memory_bytes(y0_)
+                + dr::memory_bytes(yt_) + dr::memory_bytes(mag_) + dr::memory_bytes(vec_nonzeros_);
+        }
+
+      private:
+        DynamicArray<Real> u0_{};
+        DynamicArray<Real> ut_{};
+        DynamicArray<Real> ut_dir_{};
+        DynamicArray<Covec3<Real>> grad_ut_{};
+        DynamicArray<Covec3<Real>> grad_dist_{};
+        DynamicArray<Real> lap_dist_{};
+        DynamicArray<Real> work_{};
+        bool is_solved_{};
+
+        // State of the last query needed to update it incrementally
+        DynamicArray<Real> du_{};
+        DynamicArray<Real> du_dir_{};
+        DynamicArray<Index> sources_{}; // Sorted and unique
+        DynamicArray<Index> next_sources_{};
+        DynamicArray<Index> added_{};
+        BoundaryCondition boundary_{};
+        u32 version_{};
+
+        // Dirichlet solves from sources on the boundary
+        DynamicArray<Index> bnd_sources_{};
+        DynamicArray<Real> bnd_rhs_{}; // Kept zero between solves
+        DynamicArray<Real> bnd_heat_{}; // Response to each boundary source
+        DynamicArray<Real> schur_{}; // Schur complement followed by its right-hand side
+
+        // Vector heat flow
+        DynamicArray<Real> y0_{}; // Interleaved coordinates of tangent vectors
+        DynamicArray<Real> yt_{};
+        DynamicArray<Real> mag_{};
+        DynamicArray<Index> vec_nonzeros_{};
+
+        void reserve(isize const num_verts, isize const work_size)
+        {
+            if (size(work_) < work_size)
+                work_.resize(work_size);
+
+            // NOTE(dr): Only allocates on the first query against a mesh of a given size
+            if (size(u0_) == num_verts)
+                return;
+
+            // NOTE(dr): Initial temperatures are kept zero between solves so that only source
+            // entries need to be written
+            u0_.assign(num_verts, Real{0.0});
+            ut_.resize(num_verts);
+            ut_dir_.resize(num_verts);
+            lap_dist_.resize(num_verts);
+        }
+
+        void reserve_vectors(isize const num_verts)
+        {
+            // NOTE(dr): Only allocated on the first vector query. As with u0, initial values are
+            // kept zero between solves.
+            if (size(y0_) == 2 * num_verts)
+                return;
+
+            y0_.assign(2 * num_verts, Real{0.0});
+            yt_.assign(2 * num_verts, Real{0.0});
+            mag_.resize(num_verts);
+        }
+
+        friend struct HeatMethod;
+    };
+
+    /// If true, init also assembles and factorizes the connection Laplacian used for vector heat
+    /// flow (see extend_vectors and solve_log_map). This roughly triples the memory used by the
+    /// solver.
+    bool vector_heat{false};
+
+    /// Relative residual at which solves against out of date factorizations are considered
+    /// converged (see update_positions)
+    Real lagged_tolerance{1.0e-5};
+
+    /// Same as lagged_tolerance for the Poisson solve. S is singular and single precision
+    /// residuals against it bottom out around 1e-4 so this is looser.
+    Real lagged_singular_tolerance{1.0e-3};
+
+    /// Maximum number of iterations per solve against out of date factorizations
+    isize lagged_max_iterations{50};
 
     bool init(
         Span<Vec3<Real> const> const& vertex_positions,
@@ -35,174 +243,484 @@ struct HeatMethod
         Real const time)
     {
         domain_ = {vertex_positions, face_vertices};
+        status_ = Status_Default;
 
         isize const n_v = vertex_positions.size();
-        mass_.resize(n_v);
-        u0_.resize(n_v);
-        ut_.resize(n_v);
-        lap_dist_.resize(n_v);
 
-        // Create cotan stiffness matrix
-        make_cotan_laplacian(vertex_positions, face_vertices, coeffs_);
-        S_.resize(n_v, n_v);
-        S_.setFromTriplets(coeffs_.begin(), coeffs_.end());
+        // Assemble operators
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodAssemble);
+
+            // Find boundary vertices
+            {
+                DynamicArray<Index> loop_offsets{};
+                collect_boundary_loops(face_vertices, boundary_verts_, loop_offsets);
+
+                is_boundary_.assign(n_v, 0);
+                for (auto const v : boundary_verts_)
+                    is_boundary_[v] = 1;
+            }
+
+            // Create cotan stiffness matrix
+            // NOTE(dr): Triplets are freed once S is assembled
+            DynamicArray<Triplet<Real, Index>> coeffs{};
+            make_cotan_laplacian(vertex_positions, face_vertices, coeffs);
+            S_.resize(n_v, n_v);
+            S_.setFromTriplets(coeffs.begin(), coeffs.end());
+
+            // Create diagonal mass matrix
+            mass_.resize(n_v);
+            vertex_areas_barycentric(vertex_positions, face_vertices, as_span(mass_));
+
+            if (vector_heat)
+            {
+                assemble_tangent_bases();
+                assemble_connection();
+            }
+            else
+            {
+                tangent_x_ = {};
+                tangent_y_ = {};
+                C_ = {};
+            }
+        }
+
+        if (!decomp_distance())
+            return false;
 
-        // Create diagonal mass matrix
-        vertex_areas_barycentric(vertex_positions, face_vertices, as_span(mass_));
+        // NOTE(dr): A = (M - t S) has the same sparsity pattern as S for any t so symbolic
+        // factorization only needs to be done once per mesh
+        A_ = S_;
+        heat_solver_.analyze(A_);
 
-        // Initialize solvers
-        if (decomp_heat(time) && decomp_distance())
+        // Dirichlet conditions decouple boundary vertices from the rest of the system
+        if (has_boundary())
         {
-            status_ = Status_Initialized;
-            return true;
+            A_dir_ = A_;
+            A_dir_.prune([&](Index const i, Index const j, Real const /*value*/) {
+                return i == j || !(is_boundary_[i] || is_boundary_[j]);
+            });
+            heat_dir_solver_.analyze(A_dir_);
+        }
+        else
+        {
+            A_dir_ = {};
+        }
+
+        // NOTE(dr): As with A, the vector heat operator has the same sparsity pattern as C
+        if (has_vector_heat())
+        {
+            A_vec_ = C_;
+            vec_solver_.analyze(A_vec_);
         }
         else
         {
-            status_ = Status_Default;
+            A_vec_ = {};
+        }
+
+        status_ = Status_Assembled;
+
+        if (!decomp_heat(time))
             return false;
+
+        status_ = Status_Initialized;
+        return true;
+    }
+
+    /// Updates operators after vertices have moved. Connectivity must be the same as in the last
+    /// call to init. Matrix values are updated in place and factorizations reuse the sparsity
+    /// pattern and symbolic analysis of each system. If `refactor` is false, the existing
+    /// factorizations are kept instead and used to precondition conjugate gradient solves against
+    /// the updated operators. This is much cheaper for small deformations (e.g. between frames of
+    /// an animation) but solves become iterative so refactor periodically. If refactoring fails,
+    /// positions can still be updated again (e.g. once the mesh is no longer degenerate).
+    bool update_positions(
+        Span<Vec3<Real> const> const& vertex_positions,
+        Real const time,
+        bool const refactor = true)
+    {
+        assert(status_ >= Status_Analyzed);
+        assert(vertex_positions.size() == S_.rows());
+
+        // NOTE(dr): Factorizations can only be kept if they're all valid
+        bool const can_lag = is_init();
+
+        domain_.vertex_positions = vertex_positions;
+        status_ = Status_Analyzed;
+
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodAssemble);
+            assemble_stiffness();
+            vertex_areas_barycentric(vertex_positions, domain_.face_vertices, as_span(mass_));
+
+            if (has_vector_heat())
+            {
+                assemble_tangent_bases();
+                update_connection();
+            }
         }
+
+        if (!refactor && can_lag)
+        {
+            assemble_heat(time);
+            is_heat_lagged_ = is_dist_lagged_ = true;
+            status_ = Status_Initialized;
+            return true;
+        }
+
+        if (!decomp_distance(false))
+            return false;
+
+        status_ = Status_Assembled;
+
+        if (!decomp_heat(time))
+            return false;
+
+        status_ = Status_Initialized;
+        return true;
     }
 
     bool reinit(Real const time)
     {
-        assert(is_init());
+        assert(is_assembled());
 
         if (!decomp_heat(time))
         {
-            status_ = Status_Default;
+            status_ = Status_Assembled;
             return false;
         }
 
+        status_ = Status_Initialized;
         return true;
     }
 
     void solve(
         Span<const Index> const& source_vertices,
         Span<Real> const& result,
-        bool const store_grads = false)
+        Workspace& workspace,
+        BoundaryCondition const boundary = BoundaryCondition_Neumann,
+        bool const store_grads = false) const
     {
         assert(is_init());
 
-        auto const& [vert_coords, face_verts] = domain_;
-        auto u0 = as_span(u0_);
-        auto ut = as_span(ut_);
-        auto lap_dist = as_span(lap_dist_);
+        auto& ws = workspace;
+        ws.reserve(domain_.vertex_positions.size(), work_size());
+        ws.is_solved_ = false;
+
+        auto u0 = as_span(ws.u0_);
 
         // Set initial temperatures
-        as_vec(u0).setZero();
         for (auto const v : source_vertices)
             u0[v] = mass_[v];
 
-        // Solve for temperature at the given time
-        as_vec(ut) = heat_solver_.solve(as_vec(u0));
+        bool const ok = solve_heat(
+            source_vertices,
+            as_span(ws.ut_),
+            as_span(ws.ut_dir_),
+            ws,
+            boundary);
+
+        // Reset initial temperatures
+        for (auto const v : source_vertices)
+            u0[v] = Real{0.0};
+
+        // NOTE(dr): Temperatures no longer match the sources recorded by solve_incremental. The
+        // operator version starts at 1 so this forces its next call to do a full solve.
+        ws.version_ = 0;
+
+        if (!ok)
+            return;
+
+        solve_distance(source_vertices, result, ws, store_grads);
+    }
+
+    /// Same as solve but updates the result of the previous call made with the given workspace
+    /// (against this solver) when sources were only added since. Heat flow is linear in the
+    /// initial temperatures so only the response to the added sources is solved for and added to
+    /// the previous temperatures. The result is expected to hold the previous distance which
+    /// iterative solvers start from. Falls back to a full solve if the previous query used a
+    /// different time or boundary condition or if any of its sources were removed.
+    void solve_incremental(
+        Span<const Index> const& source_vertices,
+        Span<Real> const& result,
+        Workspace& workspace,
+        BoundaryCondition const boundary = BoundaryCondition_Neumann,
+        bool const store_grads = false) const
+    {
+        assert(is_init());
+
+        auto& ws = workspace;
+        auto& prev_srcs = ws.sources_;
+        auto& next_srcs = ws.next_sources_;
+        auto& added = ws.added_;
+
+        next_srcs.assign(source_vertices.begin(), source_vertices.end());
+        std::sort(next_srcs.begin(), next_srcs.end());
+        next_srcs.erase(std::unique(next_srcs.begin(), next_srcs.end()), next_srcs.end());
 
-        // NOTE(dr): Distance and temperature gradients can either be cached or evaluated on the fly
-        // if not needed elsewhere
-        if (store_grads)
+        bool can_update = ws.is_solved_ && ws.version_ == version_ && ws.boundary_ == boundary;
+        if (can_update)
         {
-            // Evaluate tempterature gradient
-            grad_ut_.resize(face_verts.size());
-            eval_gradient(vert_coords, ut.as_const(), face_verts, as_span(grad_ut_));
+            // NOTE(dr): Removing a source would subtract most of the heat near it which loses too
+            // much precision in the remaining temperatures
+            can_update = std::includes(
+                next_srcs.begin(),
+                next_srcs.end(),
+                prev_srcs.begin(),
+                prev_srcs.end());
+        }
 
-            // Reverse and normalize to get approx distance gradient
-            grad_dist_.resize(face_verts.size());
-            for (isize f = 0; f < face_verts.size(); ++f)
-            {
-                Covec3<f32> const& g = grad_ut_[f];
-                grad_dist_[f] = -g / g.norm();
-            }
+        // NOTE(dr): Dirichlet conditions aren't applied at sources on the boundary so the system
+        // solved with them depends on the sources
+        if (can_update && boundary != BoundaryCondition_Neumann)
+        {
+            can_update = std::none_of(next_srcs.begin(), next_srcs.end(), [&](Index const v) {
+                return is_boundary_[v];
+            });
+        }
+
+        if (!can_update)
+        {
+            solve(source_vertices, result, ws, boundary, store_grads);
 
-            // Evaluate divergence of distance gradient
-            eval_divergence(
-                vert_coords,
-                face_verts,
-                as<Vec3<Real> const>(as_span(grad_dist_)),
-                lap_dist);
+            // Remember the sources and settings that produced the current temperatures
+            std::swap(prev_srcs, next_srcs);
+            ws.boundary_ = boundary;
+            ws.version_ = version_;
+            return;
         }
-        else
+
+        ws.is_solved_ = false;
+
+        added.clear();
+        std::set_difference(
+            next_srcs.begin(),
+            next_srcs.end(),
+            prev_srcs.begin(),
+            prev_srcs.end(),
+            std::back_inserter(added));
+
+        if (!added.empty())
         {
-            as_vec(lap_dist).setZero();
+            isize const num_verts = domain_.vertex_positions.size();
+            ws.du_.resize(num_verts);
+            ws.du_dir_.resize(num_verts);
+
+            auto u0 = as_span(ws.u0_);
+            auto du = as_span(ws.du_);
+            auto du_dir = as_span(ws.du_dir_);
+
+            for (auto const v : added)
+                u0[v] = mass_[v];
 
-            // Evaluate the divergence of the normalized temperature gradient
-            for (isize f = 0; f < face_verts.size(); ++f)
+            // NOTE(dr): Iterative solvers start from the current solution which should be zero
+            // rather than the last change
+            if constexpr (Solver::is_iterative)
             {
-                auto const& f_v = face_verts[f];
+                as_vec(du).setZero();
+                as_vec(du_dir).setZero();
+            }
 
-                Covec3<Real> const f_grad_ut = eval_gradient(
-                    vert_coords[f_v[0]],
-                    vert_coords[f_v[1]],
-                    vert_coords[f_v[2]],
-                    ut_[f_v[0]],
-                    ut_[f_v[1]],
-                    ut_[f_v[2]]);
+            bool const ok = solve_heat(as_span(added).as_const(), du, du_dir, ws, boundary);
 
-                Covec3<Real> const f_grad_dist = f_grad_ut / -f_grad_ut.norm();
-                auto const f_lap_dist = eval_divergence(
-                    vert_coords[f_v[0]],
-                    vert_coords[f_v[1]],
-                    vert_coords[f_v[2]],
-                    f_grad_dist.transpose().eval());
+            for (auto const v : added)
+                u0[v] = Real{0.0};
 
-                lap_dist[f_v[0]] += f_lap_dist[0];
-                lap_dist[f_v[1]] += f_lap_dist[1];
-                lap_dist[f_v[2]] += f_lap_dist[2];
-            }
+            if (!ok)
+                return;
+
+            as_vec(as_span(ws.ut_)) += as_vec(du);
+            if (boundary != BoundaryCondition_Neumann && has_boundary())
+                as_vec(as_span(ws.ut_dir_)) += as_vec(du_dir);
         }
 
-        // Solve for geodesic distance
-        auto dist = as_vec(result);
-        dist = dist_solver_.solve(as_vec(lap_dist));
+        std::swap(prev_srcs, next_srcs);
+        solve_distance(source_vertices, result, ws, store_grads);
+    }
 
-        // Subtract off mean distance at sources
+    /// Extends tangent vectors given at source vertices to the rest of the mesh via the vector
+    /// heat method. Directions are parallel transported from nearby sources and magnitudes are
+    /// interpolated. Source vectors are projected onto the tangent plane of their vertex. Requires
+    /// vector_heat to be set before init. Returns false if heat underflowed anywhere (i.e. t is too
+    /// small relative to the size of the mesh).
+    bool extend_vectors(
+        Span<const Index> const& source_vertices,
+        Span<Vec3<Real> const> const& source_vectors,
+        Span<Vec3<Real>> const& result,
+        Workspace& workspace) const
+    {
+        assert(is_init() && has_vector_heat());
+        assert(source_vertices.size() == source_vectors.size());
+
+        auto& ws = workspace;
+        ws.reserve(domain_.vertex_positions.size(), work_size());
+        ws.reserve_vectors(domain_.vertex_positions.size());
+
+        auto u0 = as_span(ws.u0_);
+        auto ut = as_span(ws.mag_);
+
+        // Transport directions
+        for (isize i = 0; i < source_vertices.size(); ++i)
+            set_source_vector(ws, source_vertices[i], source_vectors[i]);
+
+        bool ok = solve_vector_heat(ws);
+
+        // Interpolate magnitudes as the ratio of diffused magnitude to diffused indicator
+        // NOTE(dr): Temperature from the last distance query is overwritten here
+        ws.is_solved_ = false;
+        auto ind = as_span(ws.ut_);
         {
-            f32 sum{0.0};
+            for (isize i = 0; i < source_vertices.size(); ++i)
+                u0[source_vertices[i]] = mass_[source_vertices[i]] * source_vectors[i].norm();
+
+            ok &= solve_heat_system(heat_solver_, A_, u0.as_const(), ut, ws);
+
             for (auto const v : source_vertices)
-                sum += dist[v];
+                u0[v] = mass_[v];
 
-            dist.array() -= sum / source_vertices.size();
-        }
+            ok &= solve_heat_system(heat_solver_, A_, u0.as_const(), ind, ws);
 
-        status_ = Status_Solved;
-    }
+            for (auto const v : source_vertices)
+                u0[v] = Real{0.0};
+        }
 
-    bool is_init() const { return status_ != Status_Default; }
+        if (!ok)
+            return false;
 
-    bool is_solved() const { return status_ == Status_Solved; }
+        auto const yt = ws.vector_temperature();
+        for (isize v = 0; v < result.size(); ++v)
+        {
+            Vec2<Real> const y = yt[v].stableNormalized() * (ut[v] / ind[v]);
+            result[v] = y[0] * tangent_x_[v] + y[1] * tangent_y_[v];
+        }
 
-    Span<Real const> temperature() const
-    {
-        assert(is_solved());
-        return as_span(ut_);
+        return true;
     }
 
-    Span<Covec3<Real> const> grad_temperature() const
+    /// Solves for the logarithmic map at the given source vertex i.e. the tangent vector at the
+    /// source which points along the shortest geodesic to each vertex with length equal to the
+    /// geodesic distance. Results are coordinates in the tangent basis of the source. Geodesic
+    /// distance is also written to `distance`. Requires vector_heat to be set before init. The
+    /// workspace is left unsolved if heat underflowed anywhere (i.e. t is too small relative to
+    /// the size of the mesh).
+    void solve_log_map(
+        Index const source_vertex,
+        Span<Vec2<Real>> const& result,
+        Span<Real> const& distance,
+        Workspace& workspace,
+        BoundaryCondition const boundary = BoundaryCondition_Neumann) const
     {
-        assert(is_solved());
-        return as_span(grad_ut_);
-    }
+        assert(is_init() && has_vector_heat());
 
-    Span<Covec3<Real> const> grad_distance() const
-    {
-        assert(is_solved());
-        return as_span(grad_dist_);
-    }
+        auto& ws = workspace;
+        auto const& [vert_coords, face_verts] = domain_;
 
-    Span<Real const> lap_distance() const
-    {
-        assert(is_solved());
-        return as_span(lap_dist_);
+        // Solve for distance along with its gradient which gives the direction of the geodesic
+        // arriving at each vertex
+        solve({&source_vertex, 1}, distance, ws, boundary, true);
+        if (!ws.is_solved())
+            return;
+
+        // NOTE(dr): Unlike solve, underflow is reported as a failure since gradients are used
+        // directly
+        if (!as_vec(distance).allFinite())
+        {
+            ws.is_solved_ = false;
+            return;
+        }
+
+        // Transport the x axis of the source tangent basis
+        ws.reserve_vectors(vert_coords.size());
+        set_source_vector(ws, source_vertex, tangent_x_[source_vertex]);
+
+        if (!solve_vector_heat(ws))
+        {
+            ws.is_solved_ = false;
+            return;
+        }
+
+        // Average distance gradients of incident faces in the tangent basis of each vertex
+        for (auto& r : result)
+            r.setZero();
+
+        for (isize f = 0; f < face_verts.size(); ++f)
+        {
+            auto const& f_v = face_verts[f];
+            Vec3<Real> const g = ws.grad_dist_[f].transpose();
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Index const v = f_v[k];
+                result[v] += Vec2<Real>{g.dot(tangent_x_[v]), g.dot(tangent_y_[v])};
+            }
+        }
+
+        // NOTE(dr): The angle between the geodesic direction and the transported x axis is
+        // preserved by parallel transport so it gives the angle of the geodesic at the source
+        auto const yt = ws.vector_temperature();
+        for (isize v = 0; v < result.size(); ++v)
+        {
+            Vec2<Real> const& r = result[v];
+            Vec2<Real> const y = yt[v].stableNormalized();
+
+            Vec2<Real> const dir{r[0] * y[0] + r[1] * y[1], r[1] * y[0] - r[0] * y[1]};
+            Real const dir_norm = dir.norm();
+            result[v] = (dir_norm > Real{0.0}) ? Vec2<Real>{dir * (distance[v] / dir_norm)}
+                                               : Vec2<Real>::Zero();
+        }
     }
 
+    bool is_assembled() const { return status_ >= Status_Assembled; }
+
+    bool is_init() const { return status_ >= Status_Initialized; }
+
+    bool has_boundary() const { return !boundary_verts_.empty(); }
+
+    bool has_vector_heat() const { return C_.rows() > 0; }
+
+    /// Unit x axis of the tangent basis at each vertex. Only available with vector_heat.
+    Span<Vec3<Real> const> tangent_x() const { return as_span(tangent_x_); }
+
+    /// Unit y axis of the tangent basis at each vertex. Only available with vector_heat.
+    Span<Vec3<Real> const> tangent_y() const { return as_span(tangent_y_); }
+
+    /// Vertices of all boundary loops
+    Span<Index const> boundary_vertices() const { return as_span(boundary_verts_); }
+
     Solver const& heat_solver() const { return heat_solver_; }
 
+    Solver const& heat_dirichlet_solver() const { return heat_dir_solver_; }
+
     Solver const& distance_solver() const { return dist_solver_; }
 
+    Solver const& vector_solver() const { return vec_solver_; }
+
+    /// Returns the number of nonzeros in each matrix along with the number of bytes allocated
+    HeatMethodStats stats() const
+    {
+        HeatMethodStats result{};
+        result.nnz_stiffness = S_.nonZeros();
+        result.nnz_heat = A_.nonZeros();
+        result.nnz_heat_dirichlet = A_dir_.nonZeros();
+        result.nnz_heat_factor = heat_solver_.nnz();
+        result.nnz_heat_dirichlet_factor = heat_dir_solver_.nnz();
+        result.nnz_distance_factor = dist_solver_.nnz();
+        result.matrix_bytes = memory_bytes(S_) + memory_bytes(A_) + memory_bytes(A_dir_)
+            + memory_bytes(C_) + memory_bytes(A_vec_);
+        result.factor_bytes = heat_solver_.memory_bytes() + heat_dir_solver_.memory_bytes()
+            + dist_solver_.memory_bytes() + vec_solver_.memory_bytes();
+        result.buffer_bytes = memory_bytes(boundary_verts_) + memory_bytes(is_boundary_)
+            + memory_bytes(mass_) + memory_bytes(tangent_x_) + memory_bytes(tangent_y_);
+        return result;
+    }
+
   private:
     enum Status : u8
     {
         Status_Default = 0,
+        Status_Analyzed, // Operators are assembled and analyzed but S isn't factored
+        Status_Assembled,
         Status_Initialized,
-        Status_Solved,
     };
 
     struct
@@ -211,32 +729,605 @@ struct HeatMethod
         Span<Vec3<Index> const> face_vertices;
     } domain_{};
     Solver heat_solver_{};
+    Solver heat_dir_solver_{};
     Solver dist_solver_{};
+    Solver vec_solver_{};
     SparseMat<Real, Index> S_{};
     SparseMat<Real, Index> A_{};
-    DynamicArray<Triplet<Real, Index>> coeffs_{};
+    SparseMat<Real, Index> A_dir_{};
+    SparseMat<Real, Index> C_{}; // Connection Laplacian as a real matrix of 2x2 blocks
+    SparseMat<Real, Index> A_vec_{}; // A_vec = (M - t C)
+    DynamicArray<Index> boundary_verts_{};
+    DynamicArray<u8> is_boundary_{};
     DynamicArray<Real> mass_{};
-    DynamicArray<Real> u0_{};
-    DynamicArray<Real> ut_{};
-    DynamicArray<Covec3<f32>> grad_ut_{};
-    DynamicArray<Covec3<f32>> grad_dist_{};
-    DynamicArray<Real> lap_dist_{};
+    DynamicArray<Vec3<Real>> tangent_x_{};
+    DynamicArray<Vec3<Real>> tangent_y_{};
+    u32 version_{}; // Incremented whenever the heat operator changes
     Status status_{};
+    bool is_heat_lagged_{}; // True if factorizations are out of date (see update_positions)
+    bool is_dist_lagged_{};
 
-    bool decomp_heat(Real const time)
+    /// Number of elements of scratch storage needed by any of the solvers
+    isize work_size() const
     {
+        isize const solver_size = max(
+            max(heat_solver_.work_size(), heat_dir_solver_.work_size()),
+            max(dist_solver_.work_size(), vec_solver_.work_size()));
+
+        // Lagged solves also need storage for conjugate gradients
+        isize const max_rows = max(S_.rows(), A_vec_.rows());
+        return (is_heat_lagged_ || is_dist_lagged_) ? solver_size + 4 * max_rows : solver_size;
+    }
+
+    /// Solves for temperature given initial temperatures which are nonzero at the given vertices
+    /// only. The Dirichlet solution is also written to `ut_dir` if needed for the boundary
+    /// condition. Returns false if a lagged solve didn't converge.
+    bool solve_heat(
+        Span<Index const> const& nonzero_vertices,
+        Span<Real> const& ut,
+        Span<Real> const& ut_dir,
+        Workspace& ws,
+        BoundaryCondition const boundary) const
+    {
+        GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodSolveHeat);
+
+        auto u0 = as_span(ws.u0_);
+
+        auto const solve = [&](Solver const& solver,
+                               SparseMat<Real, Index> const& mat,
+                               Span<Real> const& x) -> bool {
+            return solve_heat_system(solver, mat, u0.as_const(), x, ws);
+        };
+
+        if (boundary == BoundaryCondition_Neumann || !has_boundary())
+            return solve(heat_solver_, A_, ut);
+
+        if (boundary == BoundaryCondition_Averaged && !solve(heat_solver_, A_, ut))
+            return false;
+
+        if (!solve_heat_dirichlet(nonzero_vertices, ut_dir, ws))
+            return false;
+
+        if (boundary == BoundaryCondition_Averaged)
+            as_vec(ut) = Real{0.5} * (as_vec(ut) + as_vec(ut_dir));
+        else
+            as_vec(ut) = as_vec(ut_dir);
+
+        return true;
+    }
+
+    /// Solves for temperature with homogeneous Dirichlet conditions at boundary vertices other
+    /// than sources. A_dir constrains all boundary vertices so any sources on the boundary are
+    /// coupled back in via the Schur complement of their rows. This takes one extra solve against
+    /// A_dir per boundary source.
+    bool solve_heat_dirichlet(
+        Span<Index const> const& nonzero_vertices,
+        Span<Real> const& ut,
+        Workspace& ws) const
+    {
+        using Iter = typename SparseMat<Real, Index>::InnerIterator;
+        using DenseMat = Eigen::Matrix<Real, Eigen::Dynamic, Eigen::Dynamic>;
+        using DenseVec = Eigen::Matrix<Real, Eigen::Dynamic, 1>;
+
+        auto u0 = as_span(ws.u0_);
+        auto& bnd_srcs = ws.bnd_sources_;
+
+        bnd_srcs.clear();
+        for (auto const v : nonzero_vertices)
+        {
+            if (is_boundary_[v] && std::count(bnd_srcs.begin(), bnd_srcs.end(), v) == 0)
+                bnd_srcs.push_back(v);
+        }
+
+        if (bnd_srcs.empty())
+            return solve_heat_system(heat_dir_solver_, A_dir_, u0.as_const(), ut, ws);
+
+        isize const n = u0.size();
+        isize const k = size(bnd_srcs);
+
+        if (size(ws.bnd_rhs_) != n)
+            ws.bnd_rhs_.assign(n, Real{0.0});
+
+        ws.bnd_heat_.resize(n * k);
+        ws.schur_.resize(k * k + k);
+
+        Eigen::Map<DenseMat> schur{ws.schur_.data(), k, k};
+        Eigen::Map<DenseVec> u_bnd{ws.schur_.data() + k * k, k};
+
+        // Move boundary sources out of the right-hand side
+        for (isize i = 0; i < k; ++i)
+        {
+            u_bnd[i] = u0[bnd_srcs[i]];
+            u0[bnd_srcs[i]] = Real{0.0};
+        }
+
+        // Solve for the response to interior sources with all boundary vertices constrained
+        if (k < nonzero_vertices.size())
+        {
+            if (!solve_heat_system(heat_dir_solver_, A_dir_, u0.as_const(), ut, ws))
+                return false;
+        }
+        else
+        {
+            as_vec(ut).setZero();
+        }
+
+        // Solve for the response to the coupling of each boundary source with its free neighbors
+        auto rhs = as_span(ws.bnd_rhs_);
+
+        for (isize j = 0; j < k; ++j)
+        {
+            auto z = as_span(ws.bnd_heat_).segment(j * n, n);
+
+            for (Iter it{A_, bnd_srcs[j]}; it; ++it)
+            {
+                if (!is_boundary_[it.row()])
+                    rhs[it.row()] = it.value();
+            }
+
+            as_vec(z).setZero();
+            bool const ok = solve_heat_system(heat_dir_solver_, A_dir_, rhs.as_const(), z, ws);
+
+            for (Iter it{A_, bnd_srcs[j]}; it; ++it)
+                rhs[it.row()] = Real{0.0};
+
+            if (!ok)
+                return false;
+        }
+
+        // Assemble the Schur complement of the free rows of boundary sources along with its
+        // right-hand side
+        for (isize i = 0; i < k; ++i)
+        {
+            for (isize j = 0; j < k; ++j)
+                schur(i, j) = A_.coeff(bnd_srcs[i], bnd_srcs[j]);
+
+            for (Iter it{A_, bnd_srcs[i]}; it; ++it)
+            {
+                if (is_boundary_[it.row()])
+                    continue;
+
+                u_bnd[i] -= it.value() * ut[it.row()];
+                for (isize j = 0; j < k; ++j)
+                    schur(i, j) -= it.value() * ws.bnd_heat_[j * n + it.row()];
+            }
+        }
+
+        // NOTE(dr): The Schur complement of an SPD matrix is also SPD
+        Eigen::LLT<Eigen::Ref<DenseMat>> decomp{schur};
+        if (decomp.info() != Eigen::Success)
+            return false;
+
+        decomp.solveInPlace(u_bnd);
+
+        // Combine the responses
+        for (isize j = 0; j < k; ++j)
+        {
+            auto const z = as_span(ws.bnd_heat_).segment(j * n, n);
+            as_vec(ut) -= u_bnd[j] * as_vec(z);
+        }
+
+        for (isize i = 0; i < k; ++i)
+            ut[bnd_srcs[i]] = u_bnd[i];
+
+        return true;
+    }
+
+    /// Solves one of the heat flow systems. Returns false if a lagged solve didn't converge.
+    bool solve_heat_system(
+        Solver const& solver,
+        SparseMat<Real, Index> const& mat,
+        Span<Real const> const& b,
+        Span<Real> const& x,
+        Workspace& ws) const
+    {
+        auto work = as_span(ws.work_);
+
+        if (is_heat_lagged_)
+            return solve_lagged(solver, mat, b, x, work, false);
+
+        solver.solve(b, x, work);
+        return true;
+    }
+
+    /// Sets the initial value of vector heat flow at the given vertex
+    void set_source_vector(Workspace& ws, Index const vertex, Vec3<Real> const& vector) const
+    {
+        Real const m = mass_[vertex];
+        ws.y0_[2 * vertex] = m * vector.dot(tangent_x_[vertex]);
+        ws.y0_[2 * vertex + 1] = m * vector.dot(tangent_y_[vertex]);
+        ws.vec_nonzeros_.push_back(2 * vertex);
+        ws.vec_nonzeros_.push_back(2 * vertex + 1);
+    }
+
+    /// Solves for vector heat flow from the initial values set in the workspace which are then
+    /// reset
+    bool solve_vector_heat(Workspace& ws) const
+    {
+        GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodSolveHeat);
+
+        auto y0 = as_span(ws.y0_);
+        auto yt = as_span(ws.yt_);
+        bool const ok = solve_heat_system(vec_solver_, A_vec_, y0.as_const(), yt, ws);
+
+        for (auto const i : ws.vec_nonzeros_)
+            y0[i] = Real{0.0};
+
+        ws.vec_nonzeros_.clear();
+
+        if (!ok)
+            return false;
+
+        // NOTE(dr): Vector heat decays faster than scalar heat (transport around curved regions
+        // cancels it out) so it underflows sooner if t is too small. Directions are undefined
+        // wherever it does.
+        for (auto const& y : ws.vector_temperature())
+        {
+            if (!(y.cwiseAbs().maxCoeff() > Real{0.0}))
+                return false;
+        }
+
+        return true;
+    }
+
+    /// Solves a system via conjugate gradients preconditioned with an out of date factorization.
+    /// The null space of singular systems is assumed to be constant.
+    bool solve_lagged(
+        Solver const& solver,
+        SparseMat<Real, Index> const& mat,
+        Span<Real const> const& b,
+        Span<Real> const& x,
+        Span<Real> const& work,
+        bool const is_singular) const
+    {
+        isize const n = b.size();
+        auto const solver_work = work.segment(4 * n, work.size() - 4 * n);
+
+        auto const apply = [&](Span<Real const> const& src, Span<Real> const& dst) {
+            as_vec(dst).noalias() = mat * as_vec(src);
+        };
+
+        auto const precond = [&](Span<Real const> const& src, Span<Real> const& dst) {
+            // NOTE(dr): Iterative solvers warm start from dst which must be zero for the
+            // preconditioner to be a fixed operator
+            as_vec(dst).setZero();
+            solver.solve(src, dst, solver_work);
+
+            if (is_singular)
+                as_vec(dst).array() -= as_vec(dst).mean();
+        };
+
+        // NOTE(dr): Starting from the solution against the out of date factorization keeps the
+        // full range of the direct solve (e.g. heat far from sources) which conjugate gradients
+        // would otherwise only resolve to within the tolerance
+        precond(b, x);
+
+        isize const num_iters = solve_conjugate_gradient(
+            apply,
+            precond,
+            b,
+            x,
+            work.segment(0, n),
+            work.segment(n, n),
+            work.segment(2 * n, n),
+            work.segment(3 * n, n),
+            (is_singular) ? lagged_singular_tolerance : lagged_tolerance,
+            lagged_max_iterations);
+
+        return num_iters >= 0;
+    }
+
+    /// Solves for distance from the temperatures in the workspace
+    void solve_distance(
+        Span<const Index> const& source_vertices,
+        Span<Real> const& result,
+        Workspace& ws,
+        bool const store_grads) const
+    {
+        auto const& [vert_coords, face_verts] = domain_;
+        auto ut = as_span(ws.ut_).as_const();
+        auto lap_dist = as_span(ws.lap_dist_);
+        auto work = as_span(ws.work_);
+
+        // NOTE(dr): Iterative solves only resolve temperatures to within some tolerance of their
+        // peak so values far from sources can be noise rather than just small. As with underflow
+        // in direct solves, a larger t is needed in this case.
+        if (Solver::is_iterative || is_heat_lagged_)
+        {
+            if (as_vec(ut).minCoeff() < Real{0.0})
+                return;
+        }
+
+        // Evaluate divergence of the approximate distance gradient
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodDivergence);
+
+            // NOTE(dr): Distance and temperature gradients can either be cached or evaluated on
+            // the fly if not needed elsewhere
+            if (store_grads)
+            {
+                // NOTE(dr): Gradient buffers are only allocated on first use
+                if (size(ws.grad_ut_) != face_verts.size())
+                {
+                    ws.grad_ut_.resize(face_verts.size());
+                    ws.grad_dist_.resize(face_verts.size());
+                }
+
+                // Evaluate tempterature gradient
+                eval_gradient(vert_coords, ut, face_verts, as_span(ws.grad_ut_));
+
+                // Reverse and normalize to get approx distance gradient
+                for (isize f = 0; f < face_verts.size(); ++f)
+                {
+                    Covec3<Real> const& g = ws.grad_ut_[f];
+                    ws.grad_dist_[f] = -g / g.norm();
+                }
+
+                // Evaluate divergence of distance gradient
+                eval_divergence(
+                    vert_coords,
+                    face_verts,
+                    as<Vec3<Real> const>(as_span(ws.grad_dist_)),
+                    lap_dist);
+            }
+            else
+            {
+                eval_divergence_distance_gradient(vert_coords, face_verts, ut, lap_dist);
+            }
+        }
+
+        // Solve for geodesic distance
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodSolvePoisson);
+
+            if (is_dist_lagged_)
+            {
+                // NOTE(dr): S is singular so the constant component of b (zero in exact
+                // arithmetic) is removed for conjugate gradients to converge
+                as_vec(lap_dist).array() -= as_vec(lap_dist).mean();
+
+                if (!solve_lagged(dist_solver_, S_, lap_dist.as_const(), result, work, true))
+                    return;
+            }
+            else
+            {
+                dist_solver_.solve(lap_dist.as_const(), result, work);
+            }
+        }
+
+        // Subtract off mean distance at sources
+        {
+            auto dist = as_vec(result);
+            Real sum{0.0};
+            for (auto const v : source_vertices)
+                sum += dist[v];
+
+            dist.array() -= sum / source_vertices.size();
+        }
+
+        ws.is_solved_ = true;
+    }
+
+    /// Updates the values of A and A_dir
+    void assemble_heat(Real const time)
+    {
+        ++version_;
+
         // A = (M - t S)
-        A_ = -time * S_;
+        // NOTE(dr): Values are updated in place since A shares its sparsity pattern with S
+        A_.coeffs() = -time * S_.coeffs();
         A_.diagonal() += as_vec(as_span(mass_));
 
-        heat_solver_.compute(A_);
-        return heat_solver_.info() == Eigen::Success;
+        // A_vec = (M - t C) where each vertex has a 2x2 block of mass
+        if (has_vector_heat())
+        {
+            A_vec_.coeffs() = -time * C_.coeffs();
+
+            auto diag = A_vec_.diagonal();
+            for (isize i = 0; i < size(mass_); ++i)
+            {
+                diag[2 * i] += mass_[i];
+                diag[2 * i + 1] += mass_[i];
+            }
+        }
+
+        if (has_boundary())
+        {
+            using Iter = typename SparseMat<Real, Index>::InnerIterator;
+
+            // Copy values from A. Each column of A_dir is a subsequence of the same column of A.
+            for (Index j = 0; j < A_.outerSize(); ++j)
+            {
+                Iter it_dir{A_dir_, j};
+                for (Iter it{A_, j}; it && it_dir; ++it)
+                {
+                    if (it.row() == it_dir.row())
+                    {
+                        it_dir.valueRef() = it.value();
+                        ++it_dir;
+                    }
+                }
+            }
+        }
+    }
+
+    bool decomp_heat(Real const time)
+    {
+        GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodDecompHeat);
+        assemble_heat(time);
+        is_heat_lagged_ = false;
+
+        if (!heat_solver_.factorize(A_))
+            return false;
+
+        if (has_boundary() && !heat_dir_solver_.factorize(A_dir_))
+            return false;
+
+        if (has_vector_heat() && !vec_solver_.factorize(A_vec_))
+            return false;
+
+        return true;
+    }
+
+    bool decomp_distance(bool const analyze = true)
+    {
+        GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodDecompDistance);
+
+        // NOTE(dr): S is singular since distance is only determined up to a constant
+        if (analyze)
+            dist_solver_.analyze(S_, true);
+
+        is_dist_lagged_ = false;
+        return dist_solver_.factorize(S_);
+    }
+
+    /// Recomputes the values of S from current vertex positions
+    void assemble_stiffness()
+    {
+        auto const& [vert_coords, face_verts] = domain_;
+
+        // NOTE(dr): Cotan weights match those of make_cotan_laplacian. Values are accumulated in
+        // place since the sparsity pattern of S doesn't depend on vertex positions.
+        S_.coeffs().setZero();
+
+        for (isize f = 0; f < face_verts.size(); ++f)
+        {
+            auto const& f_v = face_verts[f];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Index const i = f_v[(k + 1) % 3];
+                Index const j = f_v[(k + 2) % 3];
+
+                Vec3<Real> const& p = vert_coords[f_v[k]];
+                Vec3<Real> const d1 = vert_coords[i] - p;
+                Vec3<Real> const d2 = vert_coords[j] - p;
+                Real const w = Real{0.5} * d1.dot(d2) / d1.cross(d2).norm();
+
+                S_.coeffRef(i, j) += w;
+                S_.coeffRef(j, i) += w;
+                S_.coeffRef(i, i) -= w;
+                S_.coeffRef(j, j) -= w;
+            }
+        }
+    }
+
+    /// Computes a tangent basis at each vertex. The normal is area weighted and the x axis is
+    /// aligned with the first outgoing edge.
+    void assemble_tangent_bases()
+    {
+        auto const& [vert_coords, face_verts] = domain_;
+        isize const n_v = vert_coords.size();
+
+        // NOTE(dr): Vertex normals are accumulated in the y axes
+        tangent_x_.assign(n_v, Vec3<Real>::Zero());
+        tangent_y_.assign(n_v, Vec3<Real>::Zero());
+
+        for (isize f = 0; f < face_verts.size(); ++f)
+        {
+            auto const& f_v = face_verts[f];
+            Vec3<Real> const& p0 = vert_coords[f_v[0]];
+            Vec3<Real> const f_n = (vert_coords[f_v[1]] - p0).cross(vert_coords[f_v[2]] - p0);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Index const v = f_v[k];
+                tangent_y_[v] += f_n;
+
+                if (tangent_x_[v].isZero())
+                    tangent_x_[v] = vert_coords[f_v[(k + 1) % 3]] - vert_coords[v];
+            }
+        }
+
+        for (isize v = 0; v < n_v; ++v)
+        {
+            Vec3<Real> const n = tangent_y_[v].normalized();
+            Vec3<Real>& x = tangent_x_[v];
+            x = (x - n.dot(x) * n).normalized();
+            tangent_y_[v] = n.cross(x);
+        }
+    }
+
+    /// Evaluates the connection Laplacian from current vertex positions and tangent bases, passing
+    /// each contribution to `add(row, col, value)`. Tangent vectors are transported across each
+    /// edge by the rotation which preserves their angle with the edge.
+    template <typename Add>
+    void eval_connection(Add&& add) const
+    {
+        auto const& [vert_coords, face_verts] = domain_;
+
+        for (isize f = 0; f < face_verts.size(); ++f)
+        {
+            auto const& f_v = face_verts[f];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Index const i = f_v[(k + 1) % 3];
+                Index const j = f_v[(k + 2) % 3];
+
+                Vec3<Real> const& p = vert_coords[f_v[k]];
+                Vec3<Real> const d1 = vert_coords[i] - p;
+                Vec3<Real> const d2 = vert_coords[j] - p;
+                Real const w = Real{0.5} * d1.dot(d2) / d1.cross(d2).norm();
+
+                // Angle of the edge in the tangent basis of each end
+                Vec3<Real> const e = d2 - d1;
+                Real const a_i = std::atan2(e.dot(tangent_y_[i]), e.dot(tangent_x_[i]));
+                Real const a_j = std::atan2(e.dot(tangent_y_[j]), e.dot(tangent_x_[j]));
+
+                // Rotation from j to i as a complex number
+                Real const c = w * std::cos(a_i - a_j);
+                Real const s = w * std::sin(a_i - a_j);
+
+                Index const bi = 2 * i;
+                Index const bj = 2 * j;
+
+                add(bi, bj, c);
+                add(bi, bj + 1, -s);
+                add(bi + 1, bj, s);
+                add(bi + 1, bj + 1, c);
+
+                // Rotation from i to j is the conjugate
+                add(bj, bi, c);
+                add(bj, bi + 1, s);
+                add(bj + 1, bi, -s);
+                add(bj + 1, bi + 1, c);
+
+                add(bi, bi, -w);
+                add(bi + 1, bi + 1, -w);
+                add(bj, bj, -w);
+                add(bj + 1, bj + 1, -w);
+            }
+        }
     }
 
-    bool decomp_distance()
+    /// Assembles the connection Laplacian C
+    void assemble_connection()
     {
-        dist_solver_.compute(S_);
-        return dist_solver_.info() == Eigen::Success;
+        auto const& [vert_coords, face_verts] = domain_;
+        isize const n_v = vert_coords.size();
+
+        DynamicArray<Triplet<Real, Index>> coeffs{};
+        coeffs.reserve(face_verts.size() * 36);
+
+        eval_connection([&](Index const i, Index const j, Real const value) {
+            coeffs.push_back({i, j, value});
+        });
+
+        C_.resize(2 * n_v, 2 * n_v);
+        C_.setFromTriplets(coeffs.begin(), coeffs.end());
+    }
+
+    /// Recomputes the values of C from current vertex positions and tangent bases
+    void update_connection()
+    {
+        // NOTE(dr): As with S, values are accumulated in place since the sparsity pattern of C
+        // doesn't depend on vertex positions
+        C_.coeffs().setZero();
+
+        eval_connection([&](Index const i, Index const j, Real const value) {
+            C_.coeffRef(i, j) += value;
+        });
     }
 };
 
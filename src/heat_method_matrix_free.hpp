@@ -0,0 +1,439 @@
+#pragma once
+
+/*
+    Memory-bounded variant of the heat method which never assembles or factorizes the Laplacian.
+    Both linear systems are solved with Jacobi-preconditioned conjugate gradients, applying
+    operators face by face from cached cotan weights. Memory use is linear in mesh size (i.e. no
+    factorization fill-in) at the cost of slower solves.
+
+    Refs
+    https://www.cs.cmu.edu/~kmcrane/Projects/HeatMethod/paperCACM.pdf
+*/
+
+#include <cassert>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math_types.hpp>
+#include <dr/mesh_attributes.hpp>
+#include <dr/span.hpp>
+
+#include "conjugate_gradient.hpp"
+#include "heat_method.hpp"
+#include "memory_stats.hpp"
+#include "mesh_utils.hpp"
+#include "solver_profile.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct HeatMethodMatrixFree
+{
+    /// Scratch memory and intermediate results of a single query
+    struct Workspace
+    {
+        bool is_solved() const { return is_solved_; }
+
+        Span<Real const> temperature() const
+        {
+            assert(is_solved());
+            return as_span(ut_);
+        }
+
+        Span<Real const> lap_distance() const
+        {
+            assert(is_solved());
+            return as_span(lap_dist_);
+        }
+
+        /// Total number of solver iterations taken by the last query
+        isize num_iterations() const { return num_iters_; }
+
+        /// Returns the number of bytes allocated by the workspace
+        usize memory_bytes() const
+        {
+            return dr::memory_bytes(u0_) + dr::memory_bytes(ut_) + dr::memory_bytes(ut_dir_)
+                + dr::memory_bytes(lap_dist_) + dr::memory_bytes(cg_.r) + dr::memory_bytes(cg_.z)
+                + dr::memory_bytes(cg_.p) + dr::memory_bytes(cg_.q)
+                + dr::memory_bytes(is_fixed_);
+        }
+
+      private:
+        DynamicArray<Real> u0_{};
+        DynamicArray<Real> ut_{};
+        DynamicArray<Real> ut_dir_{};
+        DynamicArray<Real> lap_dist_{};
+        ConjugateGradientWork<Real> cg_{};
+        DynamicArray<u8> is_fixed_{}; // Vertices constrained by Dirichlet conditions
+        isize num_iters_{};
+        bool is_solved_{};
+
+        void reserve(isize const num_verts)
+        {
+            if (size(u0_) == num_verts)
+                return;
+
+            u0_.assign(num_verts, Real{0.0});
+            ut_.resize(num_verts);
+            ut_dir_.resize(num_verts);
+            lap_dist_.resize(num_verts);
+            cg_.resize(num_verts);
+        }
+
+        friend struct HeatMethodMatrixFree;
+    };
+
+    /// Relative residual at which iterative solves are considered converged. Heat far from sources
+    /// is only resolved if it's above this fraction of the peak temperature.
+    // NOTE(dr): Heat decays roughly as exp(-d^2 / 4t) with distance d so at the default t it falls
+    // well below what a single precision solve can resolve on larger meshes. Tightening the
+    // tolerance doesn't help since residuals stall near working precision. Grow t instead.
+    Real tolerance{1.0e-5};
+
+    /// Maximum number of iterations per linear solve
+    isize max_iterations{10000};
+
+    bool init(
+        Span<Vec3<Real> const> const& vertex_positions,
+        Span<Vec3<Index> const> const& face_vertices,
+        Real const time)
+    {
+        domain_ = {vertex_positions, face_vertices};
+        status_ = Status_Default;
+
+        GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodAssemble);
+        assemble_weights();
+
+        // Find boundary vertices
+        {
+            DynamicArray<Index> loop_offsets{};
+            collect_boundary_loops(face_vertices, boundary_verts_, loop_offsets);
+
+            is_boundary_.assign(vertex_positions.size(), 0);
+            for (auto const v : boundary_verts_)
+                is_boundary_[v] = 1;
+        }
+
+        status_ = Status_Assembled;
+        return reinit(time);
+    }
+
+    /// Updates cached weights after vertices have moved. Connectivity must be the same as in the
+    /// last call to init.
+    bool update_positions(Span<Vec3<Real> const> const& vertex_positions, Real const time)
+    {
+        assert(is_assembled());
+        assert(vertex_positions.size() == size(mass_));
+
+        domain_.vertex_positions = vertex_positions;
+
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodAssemble);
+            assemble_weights();
+        }
+
+        return reinit(time);
+    }
+
+    bool reinit(Real const time)
+    {
+        assert(is_assembled());
+
+        // NOTE(dr): There's nothing to factorize here but the heat operator still needs a positive
+        // diagonal to be used as a preconditioner
+        for (isize i = 0; i < size(mass_); ++i)
+        {
+            if (!(mass_[i] + time * stiff_diag_[i] > Real{0.0}))
+            {
+                status_ = Status_Assembled;
+                return false;
+            }
+        }
+
+        time_ = time;
+        status_ = Status_Initialized;
+        return true;
+    }
+
+    /// Solves for distance from the given source vertices. The workspace is left unsolved if heat
+    /// wasn't resolved everywhere (see tolerance) which is common at the default t. Callers should
+    /// retry with a larger t in this case (see solve_with_retry).
+    void solve(
+        Span<const Index> const& source_vertices,
+        Span<Real> const& result,
+        Workspace& workspace,
+        BoundaryCondition const boundary = BoundaryCondition_Neumann) const
+    {
+        assert(is_init());
+
+        auto const& [vert_coords, face_verts] = domain_;
+        auto& ws = workspace;
+        ws.reserve(vert_coords.size());
+        ws.num_iters_ = 0;
+        ws.is_solved_ = false;
+
+        auto u0 = as_span(ws.u0_);
+        auto ut = as_span(ws.ut_);
+        auto lap_dist = as_span(ws.lap_dist_);
+
+        auto const solve_heat = [&](Span<u8 const> const& is_fixed, Span<Real> const& x) {
+            auto const apply = [&](Span<Real const> const& src, Span<Real> const& dst) {
+                apply_heat(src, dst, is_fixed);
+            };
+
+            auto const precond = [&](Span<Real const> const& src, Span<Real> const& dst) {
+                as_vec(dst) = as_vec(src).array()
+                    / (as_vec(as_span(mass_)).array()
+                       + time_ * as_vec(as_span(stiff_diag_)).array());
+            };
+
+            as_vec(x).setZero();
+            accum_iterations(
+                ws,
+                solve_conjugate_gradient(
+                    apply,
+                    precond,
+                    u0.as_const(),
+                    x,
+                    ws.cg_,
+                    tolerance,
+                    max_iterations));
+        };
+
+        // Set initial temperatures
+        for (auto const v : source_vertices)
+            u0[v] = mass_[v];
+
+        // Solve for temperature at the given time
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodSolveHeat);
+
+            if (boundary == BoundaryCondition_Neumann || !has_boundary())
+            {
+                solve_heat({}, ut);
+            }
+            else
+            {
+                auto ut_dir = as_span(ws.ut_dir_);
+
+                if (boundary == BoundaryCondition_Averaged)
+                    solve_heat({}, ut);
+
+                // Homogeneous Dirichlet conditions at boundary vertices other than sources
+                auto& is_fixed = ws.is_fixed_;
+                is_fixed.assign(is_boundary_.begin(), is_boundary_.end());
+                for (auto const v : source_vertices)
+                    is_fixed[v] = 0;
+
+                solve_heat(as_span(is_fixed).as_const(), ut_dir);
+
+                if (boundary == BoundaryCondition_Averaged)
+                    as_vec(ut) = Real{0.5} * (as_vec(ut) + as_vec(ut_dir));
+                else
+                    as_vec(ut) = as_vec(ut_dir);
+            }
+        }
+
+        // Reset initial temperatures
+        for (auto const v : source_vertices)
+            u0[v] = Real{0.0};
+
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodDivergence);
+            eval_divergence_distance_gradient(vert_coords, face_verts, ut.as_const(), lap_dist);
+        }
+
+        // NOTE(dr): Conjugate gradients only spreads heat by one ring per iteration so temperatures
+        // are exactly zero wherever they fall below the solve tolerance. The resulting gradient
+        // is undefined there so bail before the Poisson solve (a larger time step is needed).
+        if (ws.num_iters_ < 0 || !as_vec(lap_dist).allFinite())
+            return;
+
+        // Solve for geodesic distance
+        {
+            GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_HeatMethodSolvePoisson);
+
+            // NOTE(dr): S is negative semidefinite so we solve (-S) y = b and negate y to get x.
+            // The constant component of b (zero in exact arithmetic) is also removed since S is
+            // singular.
+            auto b = as_vec(lap_dist);
+            b.array() -= b.mean();
+
+            auto const apply = [&](Span<Real const> const& src, Span<Real> const& dst) {
+                apply_neg_stiffness(src, dst);
+            };
+
+            auto const precond = [&](Span<Real const> const& src, Span<Real> const& dst) {
+                for (isize i = 0; i < src.size(); ++i)
+                {
+                    Real const d = stiff_diag_[i];
+                    dst[i] = (d > Real{0.0}) ? src[i] / d : src[i];
+                }
+            };
+
+            as_vec(result).setZero();
+            accum_iterations(
+                ws,
+                solve_conjugate_gradient(
+                    apply,
+                    precond,
+                    lap_dist.as_const(),
+                    result,
+                    ws.cg_,
+                    tolerance,
+                    max_iterations));
+
+            as_vec(result) = -as_vec(result);
+        }
+
+        // Subtract off mean distance at sources
+        {
+            auto dist = as_vec(result);
+            Real sum{0.0};
+            for (auto const v : source_vertices)
+                sum += dist[v];
+
+            dist.array() -= sum / source_vertices.size();
+        }
+
+        ws.is_solved_ = ws.num_iters_ >= 0;
+    }
+
+    bool is_assembled() const { return status_ != Status_Default; }
+
+    bool is_init() const { return status_ >= Status_Initialized; }
+
+    bool has_boundary() const { return !boundary_verts_.empty(); }
+
+    /// Vertices of all boundary loops
+    Span<Index const> boundary_vertices() const { return as_span(boundary_verts_); }
+
+    /// Returns the number of bytes allocated. No matrices are stored so all nonzero counts are 0.
+    HeatMethodStats stats() const
+    {
+        HeatMethodStats result{};
+        result.buffer_bytes = memory_bytes(cot_weights_) + memory_bytes(stiff_diag_)
+            + memory_bytes(mass_) + memory_bytes(boundary_verts_) + memory_bytes(is_boundary_);
+        return result;
+    }
+
+  private:
+    enum Status : u8
+    {
+        Status_Default = 0,
+        Status_Assembled,
+        Status_Initialized,
+    };
+
+    struct
+    {
+        Span<Vec3<Real> const> vertex_positions;
+        Span<Vec3<Index> const> face_vertices;
+    } domain_{};
+    DynamicArray<Vec3<Real>> cot_weights_{};
+    DynamicArray<Real> stiff_diag_{};
+    DynamicArray<Real> mass_{};
+    DynamicArray<Index> boundary_verts_{};
+    DynamicArray<u8> is_boundary_{};
+    Real time_{};
+    Status status_{};
+
+    void assemble_weights()
+    {
+        auto const& [vert_coords, face_verts] = domain_;
+        isize const n_v = vert_coords.size();
+        isize const n_f = face_verts.size();
+
+        // Cache cotan weights of edges opposite each face corner
+        cot_weights_.resize(n_f);
+        stiff_diag_.assign(n_v, Real{0.0});
+
+        for (isize f = 0; f < n_f; ++f)
+        {
+            auto const& f_v = face_verts[f];
+            auto& f_w = cot_weights_[f];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Vec3<Real> const& p = vert_coords[f_v[k]];
+                Vec3<Real> const d1 = vert_coords[f_v[(k + 1) % 3]] - p;
+                Vec3<Real> const d2 = vert_coords[f_v[(k + 2) % 3]] - p;
+                f_w[k] = Real{0.5} * d1.dot(d2) / d1.cross(d2).norm();
+
+                stiff_diag_[f_v[(k + 1) % 3]] += f_w[k];
+                stiff_diag_[f_v[(k + 2) % 3]] += f_w[k];
+            }
+        }
+
+        // Create diagonal mass matrix
+        mass_.resize(n_v);
+        vertex_areas_barycentric(vert_coords, face_verts, as_span(mass_));
+    }
+
+    static void accum_iterations(Workspace& ws, isize const num_iters)
+    {
+        // NOTE(dr): A negative count flags a solve that didn't converge
+        if (ws.num_iters_ < 0 || num_iters < 0)
+            ws.num_iters_ = -1;
+        else
+            ws.num_iters_ += num_iters;
+    }
+
+    /// Applies (M - t S). If given, vertices flagged as fixed (i.e. constrained by Dirichlet
+    /// conditions) are decoupled from their neighbors.
+    void apply_heat(
+        Span<Real const> const& x,
+        Span<Real> const& y,
+        Span<u8 const> const& is_fixed) const
+    {
+        auto const& face_verts = domain_.face_vertices;
+        as_vec(y) = as_vec(as_span(mass_)).cwiseProduct(as_vec(x));
+
+        for (isize f = 0; f < face_verts.size(); ++f)
+        {
+            auto const& f_v = face_verts[f];
+            auto const& f_w = cot_weights_[f];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Index const i = f_v[(k + 1) % 3];
+                Index const j = f_v[(k + 2) % 3];
+                Real const tw = time_ * f_w[k];
+
+                y[i] += tw * x[i];
+                y[j] += tw * x[j];
+
+                if (is_fixed.size() == 0 || !(is_fixed[i] || is_fixed[j]))
+                {
+                    y[i] -= tw * x[j];
+                    y[j] -= tw * x[i];
+                }
+            }
+        }
+    }
+
+    /// Applies -S
+    void apply_neg_stiffness(Span<Real const> const& x, Span<Real> const& y) const
+    {
+        auto const& face_verts = domain_.face_vertices;
+        as_vec(y).setZero();
+
+        for (isize f = 0; f < face_verts.size(); ++f)
+        {
+            auto const& f_v = face_verts[f];
+            auto const& f_w = cot_weights_[f];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Index const i = f_v[(k + 1) % 3];
+                Index const j = f_v[(k + 2) % 3];
+                Real const dx = f_w[k] * (x[i] - x[j]);
+                y[i] += dx;
+                y[j] -= dx;
+            }
+        }
+    }
+};
+
+} // namespace dr
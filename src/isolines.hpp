@@ -0,0 +1,273 @@
+#pragma once
+
+/*
+    Extraction of isolines from a scalar field on the vertices of a triangle mesh via marching
+    triangles. Isolines are returned as connected polylines whose points are located by face and
+    barycentric coordinates so they can be evaluated against any per-vertex attribute (see
+    eval_surface_points).
+*/
+
+#include <algorithm>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/math.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+#include "solver_profile.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct Isolines
+{
+    DynamicArray<Index> point_faces{}; // Face containing each point
+    DynamicArray<Vec3<Real>> point_coords{}; // Barycentric coordinates of each point in its face
+    DynamicArray<Index> offsets{}; // Start of each polyline followed by the total number of points
+    DynamicArray<Index> values{}; // Index of the isovalue of each polyline
+    DynamicArray<u8> is_closed{}; // Whether each polyline joins its last point to its first
+
+    isize count() const { return size(values); }
+
+    isize num_points() const { return size(point_faces); }
+
+    void clear()
+    {
+        point_faces.clear();
+        point_coords.clear();
+        offsets.clear();
+        values.clear();
+        is_closed.clear();
+    }
+};
+
+/// Reusable buffers for extract_isolines
+template <typename Index>
+struct IsolineWorkspace
+{
+    DynamicArray<Index> face_offsets{}; // Start of each face's segments followed by the total
+    DynamicArray<Index> seg_faces{};
+    DynamicArray<Index> seg_values{};
+    DynamicArray<Vec2<u8>> seg_edges{}; // Local entry and exit edge of each segment
+    DynamicArray<Vec3<Index>> entry_keys{}; // Entry edge vertices (sorted) and isovalue index
+    DynamicArray<Index> entry_order{}; // Segments sorted by entry key
+    DynamicArray<Index> next{};
+    DynamicArray<Index> prev{};
+    DynamicArray<u8> visited{};
+};
+
+namespace impl
+{
+
+template <typename Index>
+bool key_less(Vec3<Index> const& a, Vec3<Index> const& b)
+{
+    if (a[0] != b[0])
+        return a[0] < b[0];
+
+    if (a[1] != b[1])
+        return a[1] < b[1];
+
+    return a[2] < b[2];
+}
+
+template <typename Index>
+Vec3<Index> edge_key(Vec3<Index> const& f_v, u8 const edge, Index const value)
+{
+    Index const a = f_v[edge];
+    Index const b = f_v[(edge + 1) % 3];
+    return (a < b) ? Vec3<Index>{a, b, value} : Vec3<Index>{b, a, value};
+}
+
+} // namespace impl
+
+/// Extracts isolines of the given vertex values at each of the given isovalues which must be in
+/// ascending order. Within each face, vertices with values below an isovalue are separated from
+/// the rest so lines never pass exactly through a vertex. Polylines are oriented consistently
+/// (with lower values on the same side) given consistently oriented faces. Lines that reach a
+/// boundary or non-manifold edge are left open.
+template <typename Real, typename Index>
+void extract_isolines(
+    Span<Vec3<Index> const> const& face_vertices,
+    Span<Real const> const& vertex_values,
+    Span<Real const> const& isovalues,
+    Isolines<Real, Index>& result,
+    IsolineWorkspace<Index>& workspace)
+{
+    GEODESIC_HEAT_PROFILE_SCOPE(ProfileZone_ExtractIsolines);
+
+    isize const num_faces = face_vertices.size();
+    auto& ws = workspace;
+    result.clear();
+
+    // NOTE(dr): Segments are found in separate count and fill passes over faces, each of which is
+    // independent per face. This keeps the output in face order regardless of how the passes are
+    // split up.
+
+    // Count segments in each face (one per isovalue between its min and max vertex values)
+    ws.face_offsets.resize(num_faces + 1);
+    ws.face_offsets[0] = 0;
+
+    auto const value_range = [&](Vec3<Index> const& f_v) -> Vec2<isize> {
+        Real const f0 = vertex_values[f_v[0]];
+        Real const f1 = vertex_values[f_v[1]];
+        Real const f2 = vertex_values[f_v[2]];
+
+        // Isovalues in (min, max]. Most faces cross none and those that do usually cross few so
+        // the end of the range is found by linear search.
+        isize const first =
+            std::upper_bound(isovalues.begin(), isovalues.end(), min(min(f0, f1), f2))
+            - isovalues.begin();
+
+        isize last = first;
+        for (Real const f_max = max(max(f0, f1), f2); last < isovalues.size(); ++last)
+        {
+            if (isovalues[last] > f_max)
+                break;
+        }
+
+        return {first, last};
+    };
+
+    for (isize i = 0; i < num_faces; ++i)
+    {
+        Vec2<isize> const r = value_range(face_vertices[i]);
+        ws.face_offsets[i + 1] = r[1] - r[0];
+    }
+
+    for (isize i = 0; i < num_faces; ++i)
+        ws.face_offsets[i + 1] += ws.face_offsets[i];
+
+    // Fill segments
+    isize const num_segs = ws.face_offsets[num_faces];
+    ws.seg_faces.resize(num_segs);
+    ws.seg_values.resize(num_segs);
+    ws.seg_edges.resize(num_segs);
+    ws.entry_keys.resize(num_segs);
+
+    for (isize i = 0; i < num_faces; ++i)
+    {
+        isize s = ws.face_offsets[i];
+        if (s == ws.face_offsets[i + 1])
+            continue;
+
+        auto const& f_v = face_vertices[i];
+        Vec2<isize> const r = value_range(f_v);
+
+        for (isize j = r[0]; j < r[1]; ++j, ++s)
+        {
+            Real const c = isovalues[j];
+            u8 const below = u8(vertex_values[f_v[0]] < c) | u8(vertex_values[f_v[1]] < c) << 1
+                | u8(vertex_values[f_v[2]] < c) << 2;
+
+            // Enter through the edge going from above to below and exit through the edge going
+            // from below to above. Adjacent faces traverse their shared edge in opposite
+            // directions so the exit of one is the entry of the other.
+            Vec2<u8> edges = Vec2<u8>::Zero();
+            for (u8 k = 0; k < 3; ++k)
+            {
+                bool const a = (below >> k) & 1;
+                bool const b = (below >> ((k + 1) % 3)) & 1;
+
+                if (!a && b)
+                    edges[0] = k;
+                else if (a && !b)
+                    edges[1] = k;
+            }
+
+            ws.seg_faces[s] = Index(i);
+            ws.seg_values[s] = Index(j);
+            ws.seg_edges[s] = edges;
+            ws.entry_keys[s] = impl::edge_key(f_v, edges[0], Index(j));
+        }
+    }
+
+    // Link each segment to the one entered through its exit edge
+    ws.entry_order.resize(num_segs);
+    for (isize i = 0; i < num_segs; ++i)
+        ws.entry_order[i] = Index(i);
+
+    std::sort(ws.entry_order.begin(), ws.entry_order.end(), [&](Index const a, Index const b) {
+        return impl::key_less(ws.entry_keys[a], ws.entry_keys[b]);
+    });
+
+    ws.next.assign(num_segs, Index{-1});
+    ws.prev.assign(num_segs, Index{-1});
+
+    for (isize i = 0; i < num_segs; ++i)
+    {
+        Vec3<Index> const key =
+            impl::edge_key(face_vertices[ws.seg_faces[i]], ws.seg_edges[i][1], ws.seg_values[i]);
+
+        auto const it = std::lower_bound(
+            ws.entry_order.begin(),
+            ws.entry_order.end(),
+            key,
+            [&](Index const s, Vec3<Index> const& k) {
+                return impl::key_less(ws.entry_keys[s], k);
+            });
+
+        if (it == ws.entry_order.end() || ws.entry_keys[*it] != key)
+            continue;
+
+        // NOTE(dr): At non-manifold edges, more than one segment can share an entry key. Only the
+        // first is linked so each segment has at most one predecessor.
+        Index const j = *it;
+        if (ws.prev[j] < 0 && j != Index(i))
+        {
+            ws.next[i] = j;
+            ws.prev[j] = Index(i);
+        }
+    }
+
+    // Walk segments into polylines, starting with open ones
+    ws.visited.assign(num_segs, 0);
+
+    auto const push_point = [&](isize const seg, u8 const edge) {
+        auto const& f_v = face_vertices[ws.seg_faces[seg]];
+        Real const c = isovalues[ws.seg_values[seg]];
+        Real const fa = vertex_values[f_v[edge]];
+        Real const fb = vertex_values[f_v[(edge + 1) % 3]];
+        Real const t = (c - fa) / (fb - fa);
+
+        Vec3<Real> coords = Vec3<Real>::Zero();
+        coords[edge] = Real{1.0} - t;
+        coords[(edge + 1) % 3] = t;
+
+        result.point_faces.push_back(ws.seg_faces[seg]);
+        result.point_coords.push_back(coords);
+    };
+
+    auto const walk = [&](isize seg, bool const is_open) {
+        result.offsets.push_back(Index(result.num_points()));
+        result.values.push_back(ws.seg_values[seg]);
+        result.is_closed.push_back(!is_open);
+
+        if (is_open)
+            push_point(seg, ws.seg_edges[seg][0]);
+
+        while (seg >= 0 && !ws.visited[seg])
+        {
+            ws.visited[seg] = 1;
+            push_point(seg, ws.seg_edges[seg][1]);
+            seg = ws.next[seg];
+        }
+    };
+
+    for (isize i = 0; i < num_segs; ++i)
+    {
+        if (ws.prev[i] < 0)
+            walk(i, true);
+    }
+
+    for (isize i = 0; i < num_segs; ++i)
+    {
+        if (!ws.visited[i])
+            walk(i, false);
+    }
+
+    result.offsets.push_back(Index(result.num_points()));
+}
+
+} // namespace dr
@@ -0,0 +1,32 @@
+#include "memory_stats.hpp"
+
+#if __EMSCRIPTEN__
+#include <emscripten/heap.h>
+#elif __unix__ || __APPLE__
+#include <sys/resource.h>
+#endif
+
+namespace dr
+{
+
+usize peak_memory_bytes()
+{
+#if __EMSCRIPTEN__
+    return emscripten_get_heap_size();
+#elif __unix__ || __APPLE__
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#if __APPLE__
+    // NOTE(dr): Reported in bytes on macOS and kilobytes elsewhere
+    return usage.ru_maxrss;
+#else
+    return static_cast<usize>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+} // namespace dr
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <dr/basic_types.hpp>
+#include <dr/dynamic_array.hpp>
+#include <dr/math_types.hpp>
+#include <dr/sparse_linalg_types.hpp>
+
+namespace dr
+{
+
+/// Returns the peak resident memory of the current process in bytes or 0 if unavailable. On the
+/// web, this is the size of the Wasm heap which only grows.
+usize peak_memory_bytes();
+
+/// Returns the number of bytes allocated by the given array
+template <typename T>
+usize memory_bytes(DynamicArray<T> const& arr)
+{
+    return arr.capacity() * sizeof(T);
+}
+
+/// Returns the number of bytes allocated by the given array
+template <typename T, int N>
+usize memory_bytes(VecArray<T, N> const& arr)
+{
+    return arr.size() * sizeof(T);
+}
+
+/// Returns the number of bytes used by the given compressed sparse matrix
+template <typename Real, typename Index>
+usize memory_bytes(SparseMat<Real, Index> const& mat)
+{
+    return mat.nonZeros() * (sizeof(Real) + sizeof(Index)) + (mat.outerSize() + 1) * sizeof(Index);
+}
+
+} // namespace dr
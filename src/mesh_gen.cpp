@@ -0,0 +1,354 @@
+#include "mesh_gen.hpp"
+
+#include <cmath>
+
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+
+#include "mesh_utils.hpp"
+
+namespace dr
+{
+namespace
+{
+
+void assign_faces(Span<Vec3<i32> const> const& faces, MeshAsset& asset)
+{
+    auto& face_verts = asset.faces.vertex_ids;
+    face_verts.resize(3, faces.size());
+    for (isize i = 0; i < faces.size(); ++i)
+        face_verts.col(i) = faces[i];
+}
+
+} // namespace
+
+void make_icosphere(isize const num_subdivisions, MeshAsset& result)
+{
+    // Start with an icosahedron
+    f32 const t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+
+    DynamicArray<Vec3<f32>> positions{
+        {-1.0f, t, 0.0f},
+        {1.0f, t, 0.0f},
+        {-1.0f, -t, 0.0f},
+        {1.0f, -t, 0.0f},
+        {0.0f, -1.0f, t},
+        {0.0f, 1.0f, t},
+        {0.0f, -1.0f, -t},
+        {0.0f, 1.0f, -t},
+        {t, 0.0f, -1.0f},
+        {t, 0.0f, 1.0f},
+        {-t, 0.0f, -1.0f},
+        {-t, 0.0f, 1.0f},
+    };
+
+    DynamicArray<Vec3<i32>> faces{
+        {0, 11, 5},  {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9},   {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4},   {3, 4, 2},  {3, 2, 6},   {3, 6, 8},  {3, 8, 9},
+        {4, 9, 5},   {2, 4, 11}, {6, 2, 10},  {8, 6, 7},  {9, 8, 1},
+    };
+
+    for (auto& p : positions)
+        p.normalize();
+
+    // Subdivide, projecting new vertices onto the sphere
+    {
+        DynamicArray<Vec2<i32>> edges{};
+        DynamicArray<Vec3<i32>> next_faces{};
+
+        for (isize i = 0; i < num_subdivisions; ++i)
+        {
+            subdivide_midpoint(as_span(faces).as_const(), size(positions), edges, next_faces);
+
+            for (auto const& e_v : edges)
+                positions.push_back((positions[e_v[0]] + positions[e_v[1]]).normalized());
+
+            faces.swap(next_faces);
+        }
+    }
+
+    isize const num_verts = size(positions);
+    result.vertices.positions.resize(3, num_verts);
+    result.vertices.tex_coords.resize(2, num_verts);
+
+    for (isize i = 0; i < num_verts; ++i)
+    {
+        Vec3<f32> const p = positions[i].normalized();
+        result.vertices.positions.col(i) = p;
+
+        // Longitude and latitude
+        result.vertices.tex_coords.col(i) = Vec2<f32>{
+            std::atan2(p.y(), p.x()) / (2.0f * pi<f32>) + 0.5f,
+            std::acos(clamp(p.z(), -1.0f, 1.0f)) / pi<f32>,
+        };
+    }
+
+    assign_faces(as_span(faces).as_const(), result);
+    result.vertices.source_ids.clear();
+}
+
+void make_torus(
+    isize const num_major,
+    isize const num_minor,
+    f32 const major_radius,
+    f32 const minor_radius,
+    MeshAsset& result)
+{
+    isize const num_verts = num_major * num_minor;
+    result.vertices.positions.resize(3, num_verts);
+    result.vertices.tex_coords.resize(2, num_verts);
+
+    auto const vertex_id = [&](isize const i, isize const j) -> i32 {
+        return static_cast<i32>((i % num_major) * num_minor + (j % num_minor));
+    };
+
+    for (isize i = 0; i < num_major; ++i)
+    {
+        f32 const u = f32(i) / num_major;
+        f32 const cos_u = std::cos(u * 2.0f * pi<f32>);
+        f32 const sin_u = std::sin(u * 2.0f * pi<f32>);
+
+        for (isize j = 0; j < num_minor; ++j)
+        {
+            f32 const v = f32(j) / num_minor;
+            f32 const cos_v = std::cos(v * 2.0f * pi<f32>);
+            f32 const sin_v = std::sin(v * 2.0f * pi<f32>);
+            f32 const r = major_radius + minor_radius * cos_v;
+            f32 const z = minor_radius * sin_v;
+
+            i32 const k = vertex_id(i, j);
+            result.vertices.positions.col(k) = Vec3<f32>{r * cos_u, r * sin_u, z};
+            result.vertices.tex_coords.col(k) = Vec2<f32>{u, v};
+        }
+    }
+
+    auto& face_verts = result.faces.vertex_ids;
+    face_verts.resize(3, 2 * num_verts);
+
+    for (isize i = 0; i < num_major; ++i)
+    {
+        for (isize j = 0; j < num_minor; ++j)
+        {
+            i32 const v0 = vertex_id(i, j);
+            i32 const v1 = vertex_id(i + 1, j);
+            i32 const v2 = vertex_id(i + 1, j + 1);
+            i32 const v3 = vertex_id(i, j + 1);
+
+            isize const f = 2 * vertex_id(i, j);
+            face_verts.col(f) = Vec3<i32>{v0, v1, v2};
+            face_verts.col(f + 1) = Vec3<i32>{v0, v2, v3};
+        }
+    }
+
+    result.vertices.source_ids.clear();
+}
+
+void make_genus_surface(isize const genus, isize const resolution, MeshAsset& result)
+{
+    // The plate is a grid of square cells with holes spaced evenly along x. Top and bottom faces
+    // cover the solid cells and walls connect them around the outer boundary and each hole.
+    isize const n = max(resolution, isize{1});
+    isize const num_cells_x = (2 * genus + 1) * n;
+    isize const num_cells_y = (genus > 0) ? 3 * n : n;
+    isize const num_layers = n;
+    f32 const cell_size = 2.0f / num_cells_x;
+
+    auto const is_solid = [&](isize const i, isize const j) -> bool {
+        if (i < 0 || j < 0 || i >= num_cells_x || j >= num_cells_y)
+            return false;
+
+        // Holes occupy odd blocks along x in the middle block along y
+        bool const in_hole_x = (i / n) % 2 == 1;
+        bool const in_hole_y = (j / n) == 1;
+        return !(in_hole_x && in_hole_y);
+    };
+
+    // Vertices are created on first use so grid points inside holes are skipped
+    isize const num_grid_verts = (num_cells_x + 1) * (num_cells_y + 1);
+    DynamicArray<i32> vertex_ids(num_grid_verts * (num_layers + 1), -1);
+    DynamicArray<Vec3<f32>> positions{};
+    DynamicArray<Vec2<f32>> tex_coords{};
+
+    auto const vertex_id = [&](isize const i, isize const j, isize const layer) -> i32 {
+        i32& id = vertex_ids[layer * num_grid_verts + j * (num_cells_x + 1) + i];
+        if (id < 0)
+        {
+            id = static_cast<i32>(size(positions));
+
+            positions.push_back({
+                (i - num_cells_x * 0.5f) * cell_size,
+                (j - num_cells_y * 0.5f) * cell_size,
+                (num_layers * 0.5f - layer) * cell_size,
+            });
+
+            tex_coords.push_back({f32(i) / num_cells_x, f32(j) / num_cells_y});
+        }
+        return id;
+    };
+
+    DynamicArray<Vec3<i32>> faces{};
+
+    for (isize j = 0; j < num_cells_y; ++j)
+    {
+        for (isize i = 0; i < num_cells_x; ++i)
+        {
+            if (!is_solid(i, j))
+                continue;
+
+            // Cell corners in counter-clockwise order when viewed from above
+            isize const corners[][2]{{i, j}, {i + 1, j}, {i + 1, j + 1}, {i, j + 1}};
+
+            auto const corner_id = [&](int const k, isize const layer) -> i32 {
+                return vertex_id(corners[k][0], corners[k][1], layer);
+            };
+
+            // Top
+            faces.push_back({corner_id(0, 0), corner_id(1, 0), corner_id(2, 0)});
+            faces.push_back({corner_id(0, 0), corner_id(2, 0), corner_id(3, 0)});
+
+            // Bottom
+            isize const bottom = num_layers;
+            faces.push_back({corner_id(0, bottom), corner_id(2, bottom), corner_id(1, bottom)});
+            faces.push_back({corner_id(0, bottom), corner_id(3, bottom), corner_id(2, bottom)});
+
+            // Walls on sides without a solid neighbor. Side k runs from corner k to k + 1.
+            isize const neighbors[][2]{{i, j - 1}, {i + 1, j}, {i, j + 1}, {i - 1, j}};
+
+            for (int k = 0; k < 4; ++k)
+            {
+                if (is_solid(neighbors[k][0], neighbors[k][1]))
+                    continue;
+
+                for (isize layer = 0; layer < num_layers; ++layer)
+                {
+                    i32 const a0 = corner_id(k, layer);
+                    i32 const b0 = corner_id((k + 1) % 4, layer);
+                    i32 const a1 = corner_id(k, layer + 1);
+                    i32 const b1 = corner_id((k + 1) % 4, layer + 1);
+
+                    faces.push_back({b0, a0, a1});
+                    faces.push_back({b0, a1, b1});
+                }
+            }
+        }
+    }
+
+    isize const num_verts = size(positions);
+    result.vertices.positions.resize(3, num_verts);
+    result.vertices.tex_coords.resize(2, num_verts);
+
+    for (isize i = 0; i < num_verts; ++i)
+    {
+        result.vertices.positions.col(i) = positions[i];
+        result.vertices.tex_coords.col(i) = tex_coords[i];
+    }
+
+    assign_faces(as_span(faces).as_const(), result);
+    result.vertices.source_ids.clear();
+}
+
+void refine_loop(MeshAsset& asset)
+{
+    isize const num_verts = asset.vertices.count();
+    auto const face_verts = as_span(asset.faces.vertex_ids).as_const();
+
+    DynamicArray<Vec2<i32>> edges{};
+    DynamicArray<Vec3<i32>> faces{};
+    subdivide_midpoint(face_verts, num_verts, edges, faces);
+
+    isize const num_edges = size(edges);
+    auto const positions = as_span(asset.vertices.positions).as_const();
+
+    // Sum positions of vertices opposite each edge
+    DynamicArray<Vec3<f32>> opposite_sums(num_edges, Vec3<f32>::Zero());
+    DynamicArray<i8> edge_faces(num_edges, 0);
+
+    for (auto const& f_v : face_verts)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            isize const e = find_edge(as_span(edges).as_const(), f_v[i], f_v[(i + 1) % 3]);
+            opposite_sums[e] += positions[f_v[(i + 2) % 3]];
+            edge_faces[e] = min<i8>(edge_faces[e] + 1, 3);
+        }
+    }
+
+    // Sum positions of adjacent vertices separately for interior and boundary edges
+    DynamicArray<Vec3<f32>> adjacent_sums(num_verts, Vec3<f32>::Zero());
+    DynamicArray<Vec3<f32>> boundary_sums(num_verts, Vec3<f32>::Zero());
+    DynamicArray<i32> valences(num_verts, 0);
+    DynamicArray<i32> boundary_valences(num_verts, 0);
+
+    for (isize e = 0; e < num_edges; ++e)
+    {
+        auto const& e_v = edges[e];
+        adjacent_sums[e_v[0]] += positions[e_v[1]];
+        adjacent_sums[e_v[1]] += positions[e_v[0]];
+        ++valences[e_v[0]];
+        ++valences[e_v[1]];
+
+        if (edge_faces[e] != 2)
+        {
+            boundary_sums[e_v[0]] += positions[e_v[1]];
+            boundary_sums[e_v[1]] += positions[e_v[0]];
+            ++boundary_valences[e_v[0]];
+            ++boundary_valences[e_v[1]];
+        }
+    }
+
+    VecArray<f32, 3> new_positions(3, num_verts + num_edges);
+
+    // Existing vertices
+    for (isize i = 0; i < num_verts; ++i)
+    {
+        Vec3<f32> const& p = positions[i];
+
+        if (boundary_valences[i] == 0)
+        {
+            f32 const n = f32(valences[i]);
+            f32 const c = 0.375f + 0.25f * std::cos(2.0f * pi<f32> / n);
+            f32 const beta = (0.625f - c * c) / n;
+            new_positions.col(i) = (1.0f - n * beta) * p + beta * adjacent_sums[i];
+        }
+        else if (boundary_valences[i] == 2)
+        {
+            new_positions.col(i) = 0.75f * p + 0.125f * boundary_sums[i];
+        }
+        else
+        {
+            // NOTE(dr): Non-manifold and corner vertices are left in place
+            new_positions.col(i) = p;
+        }
+    }
+
+    // Edge vertices
+    for (isize e = 0; e < num_edges; ++e)
+    {
+        auto const& e_v = edges[e];
+        Vec3<f32> const mid = positions[e_v[0]] + positions[e_v[1]];
+
+        new_positions.col(num_verts + e) = (edge_faces[e] == 2)
+            ? Vec3<f32>{0.375f * mid + 0.125f * opposite_sums[e]}
+            : Vec3<f32>{0.5f * mid};
+    }
+
+    asset.vertices.positions.swap(new_positions);
+
+    // Texture coords are interpolated linearly
+    {
+        auto& tex_coords = asset.vertices.tex_coords;
+        tex_coords.conservativeResize(Eigen::NoChange, num_verts + num_edges);
+
+        for (isize e = 0; e < num_edges; ++e)
+        {
+            auto const& e_v = edges[e];
+            tex_coords.col(num_verts + e) =
+                0.5f * (tex_coords.col(e_v[0]) + tex_coords.col(e_v[1]));
+        }
+    }
+
+    assign_faces(as_span(faces).as_const(), asset);
+}
+
+} // namespace dr
@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+    Procedural mesh assets for testing at arbitrary problem sizes. Generated meshes have positions,
+    texture coordinates and faces. Vertex normals and bounds are left to the caller (as with
+    read_mesh_ply).
+*/
+
+#include "assets.hpp"
+
+namespace dr
+{
+
+/// Creates a unit sphere by subdividing an icosahedron the given number of times. The result has
+/// 20 * 4^num_subdivisions faces.
+void make_icosphere(isize num_subdivisions, MeshAsset& result);
+
+/// Creates a torus around the z axis with the given number of segments in each direction. The
+/// result has 2 * num_major * num_minor faces.
+void make_torus(
+    isize num_major,
+    isize num_minor,
+    f32 major_radius,
+    f32 minor_radius,
+    MeshAsset& result);
+
+/// Creates a closed surface of the given genus by thickening a plate with a row of square holes.
+/// `resolution` is the number of grid cells across each hole, the margins between holes and the
+/// thickness of the plate. Edges are sharp so the result is usually smoothed with refine_loop.
+void make_genus_surface(isize genus, isize resolution, MeshAsset& result);
+
+/// Splits each face into four and smooths vertex positions via Loop's scheme. Boundaries are
+/// smoothed as curves and texture coordinates are interpolated linearly. Vertex normals, bounds
+/// and source ids are not updated.
+void refine_loop(MeshAsset& asset);
+
+} // namespace dr
@@ -0,0 +1,544 @@
+#include "mesh_io.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/mesh_attributes.hpp>
+
+#include "memory_stats.hpp"
+#include "mesh_utils.hpp"
+#include "shim/happly.hpp"
+
+namespace dr
+{
+namespace
+{
+
+/// Symmetric 4x4 matrix measuring squared distance to a set of planes
+struct Quadric
+{
+    f64 a[10]{};
+
+    void add_plane(Vec3<f32> const& n, Vec3<f32> const& p, f32 const weight)
+    {
+        f64 const nx = n.x(), ny = n.y(), nz = n.z();
+        f64 const d = -n.dot(p);
+        f64 const v[]{
+            nx * nx, nx * ny, nx * nz, nx * d, ny * ny, ny * nz, ny * d, nz * nz, nz * d, d * d};
+
+        for (int i = 0; i < 10; ++i)
+            a[i] += weight * v[i];
+    }
+
+    Quadric& operator+=(Quadric const& other)
+    {
+        for (int i = 0; i < 10; ++i)
+            a[i] += other.a[i];
+
+        return *this;
+    }
+
+    f64 eval(Vec3<f32> const& p) const
+    {
+        f64 const x = p.x(), y = p.y(), z = p.z();
+        return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+            + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y + a[7] * z * z + 2.0 * a[8] * z
+            + a[9];
+    }
+};
+
+/// Interleaves the low 10 bits of each coordinate into a 30-bit Morton code
+u32 morton_code(Vec3<u32> const& c)
+{
+    auto const spread = [](u32 x) -> u32 {
+        x &= 0x3ff;
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8)) & 0x0300f00f;
+        x = (x | (x << 4)) & 0x030c30c3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    };
+
+    return spread(c[0]) | (spread(c[1]) << 1) | (spread(c[2]) << 2);
+}
+
+/// Computes the Morton code of each face's centroid on a 1024^3 grid over the bounding box of the
+/// mesh
+void make_face_codes(MeshAsset const& asset, DynamicArray<u32>& result)
+{
+    auto const positions = as_span(asset.vertices.positions).as_const();
+    auto const face_verts = as_span(asset.faces.vertex_ids).as_const();
+    result.resize(face_verts.size());
+
+    Vec3<f32> const origin = asset.vertices.positions.rowwise().minCoeff();
+    Vec3<f32> const extent = asset.vertices.positions.rowwise().maxCoeff() - origin;
+    f32 const scale = 1023.0f / max(extent.maxCoeff(), 1.0e-12f);
+
+    for (isize i = 0; i < face_verts.size(); ++i)
+    {
+        auto const& f_v = face_verts[i];
+        Vec3<f32> const p = (positions[f_v[0]] + positions[f_v[1]] + positions[f_v[2]]) / 3.0f;
+        result[i] = morton_code(((p - origin) * scale).cwiseMax(0.0f).cast<u32>());
+    }
+}
+
+} // namespace
+
+bool read_mesh_ply(char const* path, MeshAsset& asset)
+{
+    using namespace happly;
+
+    try
+    {
+        PLYData ply{path};
+        ply.validate();
+
+        // Assign vertex attributes
+        {
+            auto& ply_verts = ply.getElement("vertex");
+
+            // Positions
+            {
+                Span<f32 const> const x = get_property_data<f32>(ply_verts, "x");
+                Span<f32 const> const y = get_property_data<f32>(ply_verts, "y");
+                Span<f32 const> const z = get_property_data<f32>(ply_verts, "z");
+
+                if (!(x.is_valid() && y.is_valid() && z.is_valid()))
+                    return false;
+
+                auto& dst = asset.vertices.positions;
+                dst.resize(3, ply_verts.count);
+                dst.row(0) = as_covec(x);
+                dst.row(1) = as_covec(y);
+                dst.row(2) = as_covec(z);
+            }
+
+            // Texture coords (optional)
+            {
+                Span<f32 const> const u = get_property_data<f32>(ply_verts, "uv1");
+                Span<f32 const> const v = get_property_data<f32>(ply_verts, "uv2");
+
+                auto& dst = asset.vertices.tex_coords;
+                dst.resize(2, ply_verts.count);
+
+                if (u.is_valid())
+                    dst.row(0) = as_covec(u);
+                else
+                    dst.row(0).setConstant(0.0f);
+
+                if (v.is_valid())
+                    dst.row(1) = as_covec(v);
+                else
+                    dst.row(1).setConstant(0.0f);
+            }
+        }
+
+        // Assign face attributes
+        {
+            auto& ply_faces = ply.getElement("face");
+
+            // Vertex IDs
+            {
+                // NOTE(dr): We check a few different naming conventions here
+                static constexpr char const* prop_names[]{
+                    "vertex_indices", // Used by Blender and Houdini
+                    "vertex_index", // Used by Rhino
+                    // ...
+                };
+
+                Property* prop{};
+                for (auto name : prop_names)
+                {
+                    prop = get_property(ply_faces, name);
+                    if (prop != nullptr)
+                        break;
+                }
+
+                if (prop == nullptr)
+                    return false;
+
+                Span<i32 const> prop_data = get_list_property_data<i32>(prop);
+
+                if (!prop_data.is_valid())
+                    prop_data = as<i32>(get_list_property_data<u32>(prop));
+
+                if (!prop_data.is_valid())
+                    return false;
+
+                asset.faces.vertex_ids = as_mat(prop_data, 3);
+            }
+        }
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void compute_bounds(MeshAsset& asset)
+{
+    asset.bounds.center = area_centroid(
+        as_span(asset.vertices.positions).as_const(),
+        as_span(asset.faces.vertex_ids).as_const());
+
+    asset.bounds.radius = bounding_radius(
+        as_span(asset.vertices.positions).as_const(),
+        asset.bounds.center);
+}
+
+void compute_vertex_normals(MeshAsset& asset)
+{
+    auto& normals = asset.vertices.normals;
+    normals.resize(3, asset.vertices.count());
+
+    vertex_normals_area_weighted(
+        as_span(asset.vertices.positions).as_const(),
+        as_span(asset.faces.vertex_ids).as_const(),
+        as_span(normals));
+}
+
+void reorder_mesh(MeshAsset& asset)
+{
+    isize const num_verts = asset.vertices.count();
+    isize const num_faces = asset.faces.count();
+
+    // Reorder vertices
+    {
+        auto& vert_order = asset.vertices.source_ids;
+        make_vertex_order_rcm(as_span(asset.faces.vertex_ids).as_const(), num_verts, vert_order);
+
+        VecArray<f32, 3> positions(3, num_verts);
+        VecArray<f32, 2> tex_coords(2, num_verts);
+
+        for (isize i = 0; i < num_verts; ++i)
+        {
+            positions.col(i) = asset.vertices.positions.col(vert_order[i]);
+            tex_coords.col(i) = asset.vertices.tex_coords.col(vert_order[i]);
+        }
+
+        asset.vertices.positions.swap(positions);
+        asset.vertices.tex_coords.swap(tex_coords);
+
+        // Remap face vertices
+        DynamicArray<i32> vert_index(num_verts);
+        for (isize i = 0; i < num_verts; ++i)
+            vert_index[vert_order[i]] = static_cast<i32>(i);
+
+        for (auto& f_v : as_span(asset.faces.vertex_ids))
+        {
+            for (int j = 0; j < 3; ++j)
+                f_v[j] = vert_index[f_v[j]];
+        }
+    }
+
+    // Sort faces along a Morton curve through their centroids. Nearby faces share most of their
+    // vertices so this keeps the solver's per-face loops local and lets compute_clusters split
+    // faces into compact clusters.
+    {
+        DynamicArray<u32> face_codes{};
+        make_face_codes(asset, face_codes);
+
+        DynamicArray<i32> face_order(num_faces);
+        for (isize i = 0; i < num_faces; ++i)
+            face_order[i] = static_cast<i32>(i);
+
+        std::stable_sort(face_order.begin(), face_order.end(), [&](i32 const a, i32 const b) {
+            return face_codes[a] < face_codes[b];
+        });
+
+        VecArray<i32, 3> vertex_ids(3, num_faces);
+        for (isize i = 0; i < num_faces; ++i)
+            vertex_ids.col(i) = asset.faces.vertex_ids.col(face_order[i]);
+
+        asset.faces.vertex_ids.swap(vertex_ids);
+    }
+}
+
+void compute_clusters(MeshAsset& asset)
+{
+    // NOTE(dr): Smaller clusters cull more tightly at the cost of more draws per frame
+    constexpr isize max_cluster_faces{512};
+
+    auto const positions = as_span(asset.vertices.positions).as_const();
+    isize const num_faces = asset.faces.count();
+
+    // NOTE(dr): Faces are only sorted along a Morton curve if the mesh was reordered (see
+    // reorder_mesh). Otherwise their order is kept and clusters are consecutive runs of faces which
+    // cull less tightly.
+    DynamicArray<u32> face_codes{};
+    make_face_codes(asset, face_codes);
+    bool const is_sorted = std::is_sorted(face_codes.begin(), face_codes.end());
+
+    // NOTE(dr): Back faces of a closed mesh are always hidden by front faces so clusters can be
+    // culled by their normal cones without culling back faces in the pipeline. Open meshes show
+    // their back faces so their clusters can only be culled by the view frustum.
+    auto const face_verts = as_span(asset.faces.vertex_ids).as_const();
+    bool is_closed;
+    {
+        DynamicArray<i32> loop_verts{};
+        DynamicArray<i32> loop_offsets{};
+        collect_boundary_loops(face_verts, loop_verts, loop_offsets);
+        is_closed = loop_verts.empty();
+    }
+
+    auto& clusters = asset.clusters;
+    clusters.offsets.clear();
+
+    // Split faces into the largest octree cells with no more than the max number of faces. Faces
+    // in each cell are contiguous since they share a prefix of their Morton code.
+    auto const split = [&](auto& self, isize const start, isize const end, int const shift) {
+        if (end - start <= max_cluster_faces || shift < 0 || !is_sorted)
+        {
+            for (isize i = start; i < end; i += max_cluster_faces)
+                clusters.offsets.push_back(static_cast<i32>(i));
+
+            return;
+        }
+
+        for (isize i = start; i < end;)
+        {
+            u32 const cell = face_codes[i] >> shift;
+            isize j = i + 1;
+            while (j < end && (face_codes[j] >> shift) == cell)
+                ++j;
+
+            self(self, i, j, shift - 3);
+            i = j;
+        }
+    };
+    split(split, 0, num_faces, 27);
+
+    isize const num_clusters = size(clusters.offsets);
+    clusters.offsets.push_back(static_cast<i32>(num_faces));
+    clusters.spheres.resize(4, num_clusters);
+    clusters.cones.resize(4, num_clusters);
+
+    for (isize i = 0; i < num_clusters; ++i)
+    {
+        isize const start = clusters.offsets[i];
+        isize const end = clusters.offsets[i + 1];
+
+        // Bounding sphere about the center of the bounding box
+        Vec3<f32> box_min = positions[face_verts[start][0]];
+        Vec3<f32> box_max = box_min;
+        for (isize j = start; j < end; ++j)
+        {
+            for (auto const v : face_verts[j])
+            {
+                box_min = box_min.cwiseMin(positions[v]);
+                box_max = box_max.cwiseMax(positions[v]);
+            }
+        }
+
+        Vec3<f32> const center = 0.5f * (box_min + box_max);
+        f32 radius_sqr = 0.0f;
+        for (isize j = start; j < end; ++j)
+        {
+            for (auto const v : face_verts[j])
+                radius_sqr = max(radius_sqr, (positions[v] - center).squaredNorm());
+        }
+
+        clusters.spheres.col(i) << center, std::sqrt(radius_sqr);
+
+        // Normal cone about the mean face normal. The sine of the cone's half angle is stored such
+        // that a cone wider than a hemisphere (or any cone of an open mesh) is never culled.
+        Vec3<f32> axis = Vec3<f32>::Zero();
+        for (isize j = start; j < end; ++j)
+        {
+            auto const& f_v = face_verts[j];
+            Vec3<f32> const& p0 = positions[f_v[0]];
+            axis += (positions[f_v[1]] - p0).cross(positions[f_v[2]] - p0).normalized();
+        }
+        axis.normalize();
+
+        f32 min_cos = (is_closed && axis.allFinite()) ? 1.0f : -1.0f;
+        for (isize j = start; j < end && min_cos > 0.0f; ++j)
+        {
+            auto const& f_v = face_verts[j];
+            Vec3<f32> const& p0 = positions[f_v[0]];
+            Vec3<f32> const n = (positions[f_v[1]] - p0).cross(positions[f_v[2]] - p0);
+            f32 const n_len = n.norm();
+            if (n_len > 0.0f)
+                min_cos = min(min_cos, n.dot(axis) / n_len);
+        }
+
+        if (min_cos > 0.0f)
+            clusters.cones.col(i) << axis, std::sqrt(1.0f - min_cos * min_cos);
+        else
+            clusters.cones.col(i) << Vec3<f32>::Zero(), 1.0f;
+    }
+}
+
+void compute_lods(MeshAsset& asset)
+{
+    // NOTE(dr): Levels with fewer faces than this aren't worth a separate draw
+    constexpr isize min_faces{1024};
+    constexpr isize max_levels{12};
+
+    auto const positions = as_span(asset.vertices.positions).as_const();
+    auto const face_verts = as_span(asset.faces.vertex_ids).as_const();
+    isize const num_verts = positions.size();
+
+    auto& lods = asset.lods;
+    lods.offsets.assign(1, 0);
+    lods.errors.clear();
+
+    DynamicArray<Vec3<i32>> lod_faces{};
+    if (face_verts.size() < 2 * min_faces)
+    {
+        lods.vertex_ids.resize(3, 0);
+        return;
+    }
+
+    // Sum area-weighted plane quadrics of incident faces at each vertex
+    DynamicArray<Quadric> vert_quadrics(num_verts);
+    for (auto const& f_v : face_verts)
+    {
+        Vec3<f32> const& p0 = positions[f_v[0]];
+        Vec3<f32> const n = (positions[f_v[1]] - p0).cross(positions[f_v[2]] - p0);
+        f32 const n_len = n.norm();
+        if (n_len == 0.0f)
+            continue;
+
+        Quadric q{};
+        q.add_plane(n / n_len, p0, 0.5f * n_len);
+
+        for (int i = 0; i < 3; ++i)
+            vert_quadrics[f_v[i]] += q;
+    }
+
+    Vec3<f32> const origin = asset.vertices.positions.rowwise().minCoeff();
+    f32 cell_size = 2.0f * mean_edge_length(positions, face_verts);
+
+    DynamicArray<Vec2<i64>> cell_verts(num_verts);
+    DynamicArray<i32> rep_verts(num_verts);
+    DynamicArray<Vec3<i32>> faces{};
+    isize prev_num_faces = face_verts.size();
+
+    for (isize level = 0; level < max_levels; ++level, cell_size *= 2.0f)
+    {
+        // Sort vertices by grid cell
+        for (isize i = 0; i < num_verts; ++i)
+        {
+            Vec3<i64> const c = ((positions[i] - origin) / cell_size).cast<i64>();
+            cell_verts[i] = {(c[0] << 42) | (c[1] << 21) | c[2], i};
+        }
+
+        std::sort(cell_verts.begin(), cell_verts.end(), [](auto const& a, auto const& b) {
+            return a[0] < b[0];
+        });
+
+        // Represent each cluster by the member vertex of least error w.r.t. its summed quadric
+        for (isize i = 0; i < num_verts;)
+        {
+            isize j = i;
+            Quadric q{};
+            while (j < num_verts && cell_verts[j][0] == cell_verts[i][0])
+                q += vert_quadrics[cell_verts[j++][1]];
+
+            i32 rep = static_cast<i32>(cell_verts[i][1]);
+            f64 min_error = q.eval(positions[rep]);
+
+            for (isize k = i + 1; k < j; ++k)
+            {
+                i32 const v = static_cast<i32>(cell_verts[k][1]);
+                f64 const error = q.eval(positions[v]);
+                if (error < min_error)
+                {
+                    rep = v;
+                    min_error = error;
+                }
+            }
+
+            for (isize k = i; k < j; ++k)
+                rep_verts[cell_verts[k][1]] = rep;
+
+            i = j;
+        }
+
+        // Collapse faces, dropping those that become degenerate or duplicate
+        faces.clear();
+        for (auto const& f_v : face_verts)
+        {
+            Vec3<i32> f{rep_verts[f_v[0]], rep_verts[f_v[1]], rep_verts[f_v[2]]};
+            if (f[0] == f[1] || f[1] == f[2] || f[2] == f[0])
+                continue;
+
+            // Rotate the smallest index to the front so duplicates compare equal
+            while (f[0] > f[1] || f[0] > f[2])
+                f = {f[1], f[2], f[0]};
+
+            faces.push_back(f);
+        }
+
+        auto const less = [](Vec3<i32> const& a, Vec3<i32> const& b) {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+        };
+        std::sort(faces.begin(), faces.end(), less);
+        faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+
+        isize const num_faces = size(faces);
+        if (num_faces < min_faces)
+            break;
+
+        // Skip levels that barely simplify the previous one
+        if (num_faces * 4 > prev_num_faces * 3)
+            continue;
+
+        lod_faces.insert(lod_faces.end(), faces.begin(), faces.end());
+        lods.offsets.push_back(static_cast<i32>(size(lod_faces)));
+        lods.errors.push_back(cell_size * std::sqrt(3.0f));
+        prev_num_faces = num_faces;
+    }
+
+    lods.vertex_ids.resize(3, size(lod_faces));
+    for (isize i = 0; i < size(lod_faces); ++i)
+        lods.vertex_ids.col(i) = lod_faces[i];
+}
+
+usize memory_bytes(MeshAsset const& asset)
+{
+    auto const& verts = asset.vertices;
+    auto const& clusters = asset.clusters;
+    auto const& lods = asset.lods;
+    return memory_bytes(verts.positions) + memory_bytes(verts.normals)
+        + memory_bytes(verts.tex_coords) + memory_bytes(verts.source_ids)
+        + memory_bytes(asset.faces.vertex_ids) + memory_bytes(clusters.offsets)
+        + memory_bytes(clusters.spheres) + memory_bytes(clusters.cones)
+        + memory_bytes(lods.vertex_ids) + memory_bytes(lods.offsets) + memory_bytes(lods.errors);
+}
+
+void refine_midpoint(MeshAsset& asset)
+{
+    isize const num_verts = asset.vertices.count();
+
+    DynamicArray<Vec2<i32>> edges{};
+    DynamicArray<Vec3<i32>> faces{};
+    subdivide_midpoint(as_span(asset.faces.vertex_ids).as_const(), num_verts, edges, faces);
+
+    isize const num_new_verts = num_verts + size(edges);
+
+    // Vertex attributes at edge midpoints are interpolated linearly
+    auto const refine_attribute = [&](auto& attr) {
+        attr.conservativeResize(Eigen::NoChange, num_new_verts);
+        for (isize i = 0; i < size(edges); ++i)
+        {
+            auto const& e_v = edges[i];
+            attr.col(num_verts + i) = 0.5f * (attr.col(e_v[0]) + attr.col(e_v[1]));
+        }
+    };
+
+    refine_attribute(asset.vertices.positions);
+    refine_attribute(asset.vertices.tex_coords);
+
+    auto& face_verts = asset.faces.vertex_ids;
+    face_verts.resize(3, size(faces));
+    for (isize i = 0; i < size(faces); ++i)
+        face_verts.col(i) = faces[i];
+}
+
+} // namespace dr
@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+    Reading and processing of mesh assets. Doesn't depend on the app so it can be shared with
+    command line tools.
+*/
+
+#include "assets.hpp"
+
+namespace dr
+{
+
+/// Reads vertex positions, texture coordinates (if any) and faces from a PLY file
+bool read_mesh_ply(char const* path, MeshAsset& asset);
+
+/// Computes the bounding sphere of the mesh
+void compute_bounds(MeshAsset& asset);
+
+/// Computes area-weighted vertex normals
+void compute_vertex_normals(MeshAsset& asset);
+
+/// Reorders vertices (via RCM) and faces (along a space-filling curve) for memory locality. The
+/// original index of each vertex is written to `asset.vertices.source_ids`. Must be called before
+/// computing vertex normals.
+void reorder_mesh(MeshAsset& asset);
+
+/// Groups consecutive faces into clusters with bounding spheres and normal cones for culling. Faces
+/// aren't reordered here so clusters are most compact after reorder_mesh. Must be called after it
+/// since cluster ranges refer to the order of faces.
+void compute_clusters(MeshAsset& asset);
+
+/// Computes coarser levels of detail by clustering vertices on successively larger grids. The
+/// vertex with the least quadric error represents each cluster so levels reuse the mesh's vertices
+/// (i.e. per-vertex data doesn't need to be resampled).
+void compute_lods(MeshAsset& asset);
+
+/// Returns the number of bytes allocated by the mesh's vertex and face buffers
+usize memory_bytes(MeshAsset const& asset);
+
+/// Splits each face into four by inserting a vertex at the midpoint of each edge. Vertex normals,
+/// bounds and source ids are not updated.
+void refine_midpoint(MeshAsset& asset);
+
+} // namespace dr
@@ -0,0 +1,473 @@
+#pragma once
+
+/*
+    Connectivity utilities for indexed triangle meshes
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+
+namespace dr
+{
+
+/// Collects the unique undirected edges of the given faces. Each edge is stored with its smaller
+/// vertex index first.
+template <typename Index>
+void collect_edges(Span<Vec3<Index> const> const& face_vertices, DynamicArray<Vec2<Index>>& result)
+{
+    result.clear();
+    result.reserve(face_vertices.size() * 3);
+
+    for (auto const& f_v : face_vertices)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            Index const a = f_v[i];
+            Index const b = f_v[(i + 1) % 3];
+            result.push_back((a < b) ? Vec2<Index>{a, b} : Vec2<Index>{b, a});
+        }
+    }
+
+    auto const less = [](Vec2<Index> const& a, Vec2<Index> const& b) {
+        return (a[0] != b[0]) ? a[0] < b[0] : a[1] < b[1];
+    };
+    std::sort(result.begin(), result.end(), less);
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+/// Returns the index of the edge between the given vertices in edges collected by collect_edges
+/// or -1 if there is no such edge
+template <typename Index>
+isize find_edge(Span<Vec2<Index> const> const& edges, Index const a, Index const b)
+{
+    Vec2<Index> const key = (a < b) ? Vec2<Index>{a, b} : Vec2<Index>{b, a};
+    auto const it = std::lower_bound(
+        edges.begin(),
+        edges.end(),
+        key,
+        [](Vec2<Index> const& a, Vec2<Index> const& b) {
+            return (a[0] != b[0]) ? a[0] < b[0] : a[1] < b[1];
+        });
+
+    return (it != edges.end() && *it == key) ? it - edges.begin() : -1;
+}
+
+/// Returns the mean length of the unique edges of the given faces or 0 if there are none
+template <typename Real, typename Index>
+Real mean_edge_length(
+    Span<Vec3<Real> const> const& vertex_positions,
+    Span<Vec3<Index> const> const& face_vertices)
+{
+    // NOTE(dr): Interior edges are shared by two faces and boundary edges by one so edges are
+    // collected explicitly rather than inferred from the face count
+    DynamicArray<Vec2<Index>> edges{};
+    collect_edges(face_vertices, edges);
+
+    if (edges.empty())
+        return Real{0.0};
+
+    f64 length_sum{0.0};
+    for (auto const& e_v : edges)
+        length_sum += (vertex_positions[e_v[0]] - vertex_positions[e_v[1]]).norm();
+
+    return length_sum / size(edges);
+}
+
+/// Splits each face of the given mesh into four by inserting a vertex at the midpoint of each
+/// edge. New vertices are numbered after existing ones in the order of `edges` (i.e. the vertex
+/// created on edges[i] has index num_vertices + i).
+template <typename Index>
+void subdivide_midpoint(
+    Span<Vec3<Index> const> const& face_vertices,
+    isize const num_vertices,
+    DynamicArray<Vec2<Index>>& edges,
+    DynamicArray<Vec3<Index>>& result)
+{
+    collect_edges(face_vertices, edges);
+
+    auto const edge_vertex = [&](Index const a, Index const b) -> Index {
+        return static_cast<Index>(num_vertices + find_edge(as_span(edges).as_const(), a, b));
+    };
+
+    result.resize(face_vertices.size() * 4);
+
+    for (isize f = 0; f < face_vertices.size(); ++f)
+    {
+        auto const& f_v = face_vertices[f];
+        Index const e0 = edge_vertex(f_v[1], f_v[2]);
+        Index const e1 = edge_vertex(f_v[2], f_v[0]);
+        Index const e2 = edge_vertex(f_v[0], f_v[1]);
+
+        Vec3<Index>* const f_dst = &result[f * 4];
+        f_dst[0] = {f_v[0], e2, e1};
+        f_dst[1] = {f_v[1], e0, e2};
+        f_dst[2] = {f_v[2], e1, e0};
+        f_dst[3] = {e0, e1, e2};
+    }
+}
+
+/// Collects the boundary loops of the given faces. Vertices of all loops are written contiguously
+/// to `loop_vertices` in the order given by face orientation. `loop_offsets` receives the start of
+/// each loop followed by the total number of loop vertices.
+template <typename Index>
+void collect_boundary_loops(
+    Span<Vec3<Index> const> const& face_vertices,
+    DynamicArray<Index>& loop_vertices,
+    DynamicArray<Index>& loop_offsets)
+{
+    loop_vertices.clear();
+    loop_offsets.clear();
+
+    // Collect half edges keyed by their undirected edge
+    DynamicArray<Vec4<Index>> half_edges{};
+    half_edges.reserve(face_vertices.size() * 3);
+
+    for (auto const& f_v : face_vertices)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            Index const a = f_v[i];
+            Index const b = f_v[(i + 1) % 3];
+            half_edges.push_back((a < b) ? Vec4<Index>{a, b, a, b} : Vec4<Index>{b, a, a, b});
+        }
+    }
+
+    std::sort(half_edges.begin(), half_edges.end(), [](auto const& a, auto const& b) {
+        return (a[0] != b[0]) ? a[0] < b[0] : a[1] < b[1];
+    });
+
+    // Boundary edges are those with a single incident face
+    DynamicArray<Vec2<Index>> bnd_edges{};
+    for (isize i = 0; i < size(half_edges);)
+    {
+        auto const& key = half_edges[i];
+
+        isize j = i + 1;
+        while (j < size(half_edges) && half_edges[j][0] == key[0] && half_edges[j][1] == key[1])
+            ++j;
+
+        if (j - i == 1)
+            bnd_edges.push_back({key[2], key[3]});
+
+        i = j;
+    }
+
+    if (bnd_edges.empty())
+        return;
+
+    auto const less_start = [](Vec2<Index> const& a, Vec2<Index> const& b) { return a[0] < b[0]; };
+    std::sort(bnd_edges.begin(), bnd_edges.end(), less_start);
+
+    // Chain boundary edges into loops
+    DynamicArray<u8> visited(size(bnd_edges), 0);
+    for (isize i = 0; i < size(bnd_edges); ++i)
+    {
+        if (visited[i])
+            continue;
+
+        loop_offsets.push_back(static_cast<Index>(size(loop_vertices)));
+
+        for (isize e = i; e >= 0;)
+        {
+            visited[e] = 1;
+            loop_vertices.push_back(bnd_edges[e][0]);
+
+            // Find an unvisited edge starting where this one ends
+            Vec2<Index> const key{bnd_edges[e][1], 0};
+            auto it = std::lower_bound(bnd_edges.begin(), bnd_edges.end(), key, less_start);
+
+            e = -1;
+            for (; it != bnd_edges.end() && (*it)[0] == key[0]; ++it)
+            {
+                isize const next = it - bnd_edges.begin();
+                if (!visited[next])
+                {
+                    e = next;
+                    break;
+                }
+            }
+        }
+    }
+
+    loop_offsets.push_back(static_cast<Index>(size(loop_vertices)));
+}
+
+/// Computes a reverse Cuthill-McKee ordering of the vertices of the given faces which reduces the
+/// bandwidth of vertex adjacency (and hence of the Laplacian). `result` maps each new vertex index
+/// to its old index.
+template <typename Index>
+void make_vertex_order_rcm(
+    Span<Vec3<Index> const> const& face_vertices,
+    isize const num_vertices,
+    DynamicArray<Index>& result)
+{
+    result.clear();
+    result.reserve(num_vertices);
+
+    // Build vertex adjacency in compressed form
+    DynamicArray<Index> adj_offsets(num_vertices + 1, 0);
+    DynamicArray<Index> adj_verts{};
+    {
+        DynamicArray<Vec2<Index>> edges{};
+        collect_edges(face_vertices, edges);
+
+        for (auto const& e_v : edges)
+        {
+            ++adj_offsets[e_v[0] + 1];
+            ++adj_offsets[e_v[1] + 1];
+        }
+
+        for (isize i = 0; i < num_vertices; ++i)
+            adj_offsets[i + 1] += adj_offsets[i];
+
+        adj_verts.resize(adj_offsets[num_vertices]);
+        DynamicArray<Index> next(adj_offsets.begin(), adj_offsets.end() - 1);
+
+        for (auto const& e_v : edges)
+        {
+            adj_verts[next[e_v[0]]++] = e_v[1];
+            adj_verts[next[e_v[1]]++] = e_v[0];
+        }
+    }
+
+    auto const degree = [&](Index const v) -> Index { return adj_offsets[v + 1] - adj_offsets[v]; };
+    auto const less_degree = [&](Index const a, Index const b) { return degree(a) < degree(b); };
+
+    // NOTE(dr): Each connected component is seeded with its vertex of least degree which is a cheap
+    // stand-in for a pseudo-peripheral vertex
+    DynamicArray<Index> seeds(num_vertices);
+    for (isize i = 0; i < num_vertices; ++i)
+        seeds[i] = static_cast<Index>(i);
+
+    std::stable_sort(seeds.begin(), seeds.end(), less_degree);
+
+    // Breadth-first traversal from each seed, visiting neighbors in order of increasing degree
+    DynamicArray<u8> visited(num_vertices, 0);
+    for (auto const seed : seeds)
+    {
+        if (visited[seed])
+            continue;
+
+        visited[seed] = 1;
+        result.push_back(seed);
+
+        for (isize head = size(result) - 1; head < size(result); ++head)
+        {
+            Index const v = result[head];
+            isize const first = size(result);
+
+            for (Index i = adj_offsets[v]; i < adj_offsets[v + 1]; ++i)
+            {
+                Index const v_adj = adj_verts[i];
+                if (!visited[v_adj])
+                {
+                    visited[v_adj] = 1;
+                    result.push_back(v_adj);
+                }
+            }
+
+            std::stable_sort(result.begin() + first, result.end(), less_degree);
+        }
+    }
+
+    std::reverse(result.begin(), result.end());
+}
+
+/// Collects the neighbors of each vertex from edges collected by collect_edges. `offsets` receives
+/// the start of each vertex's neighbors followed by the total number of neighbors.
+template <typename Index>
+void collect_vertex_neighbors(
+    Span<Vec2<Index> const> const& edges,
+    isize const num_vertices,
+    DynamicArray<Index>& offsets,
+    DynamicArray<Index>& neighbors)
+{
+    offsets.assign(num_vertices + 1, 0);
+    for (auto const& e_v : edges)
+    {
+        ++offsets[e_v[0] + 1];
+        ++offsets[e_v[1] + 1];
+    }
+
+    for (isize i = 0; i < num_vertices; ++i)
+        offsets[i + 1] += offsets[i];
+
+    // NOTE(dr): Offsets are shifted back into place as neighbors are written
+    neighbors.resize(offsets[num_vertices]);
+    for (auto const& e_v : edges)
+    {
+        neighbors[offsets[e_v[0]]++] = e_v[1];
+        neighbors[offsets[e_v[1]]++] = e_v[0];
+    }
+
+    for (isize i = num_vertices; i > 0; --i)
+        offsets[i] = offsets[i - 1];
+
+    offsets[0] = 0;
+}
+
+/// Collects the faces incident to each vertex. `offsets` receives the start of each vertex's faces
+/// followed by the total number of incident faces.
+template <typename Index>
+void collect_vertex_faces(
+    Span<Vec3<Index> const> const& face_vertices,
+    isize const num_vertices,
+    DynamicArray<Index>& offsets,
+    DynamicArray<Index>& faces)
+{
+    offsets.assign(num_vertices + 1, 0);
+    for (auto const& f_v : face_vertices)
+    {
+        for (int i = 0; i < 3; ++i)
+            ++offsets[f_v[i] + 1];
+    }
+
+    for (isize i = 0; i < num_vertices; ++i)
+        offsets[i + 1] += offsets[i];
+
+    // NOTE(dr): As in collect_vertex_neighbors, offsets are shifted back into place as faces are
+    // written
+    faces.resize(offsets[num_vertices]);
+    for (isize f = 0; f < face_vertices.size(); ++f)
+    {
+        for (int i = 0; i < 3; ++i)
+            faces[offsets[face_vertices[f][i]]++] = static_cast<Index>(f);
+    }
+
+    for (isize i = num_vertices; i > 0; --i)
+        offsets[i] = offsets[i - 1];
+
+    offsets[0] = 0;
+}
+
+/// Collects the neighbors of each face across each of its edges. The neighbor across edge i (from
+/// vertex i to vertex i + 1) is stored in component i or -1 if the edge is on a boundary or has
+/// more than two incident faces.
+template <typename Index>
+void collect_face_neighbors(
+    Span<Vec3<Index> const> const& face_vertices,
+    DynamicArray<Vec3<Index>>& result)
+{
+    isize const num_faces = face_vertices.size();
+    result.assign(num_faces, Vec3<Index>::Constant(-1));
+
+    // Collect half edges keyed by their undirected edge along with their face and local index
+    DynamicArray<Vec4<Index>> half_edges{};
+    half_edges.reserve(num_faces * 3);
+
+    for (isize f = 0; f < num_faces; ++f)
+    {
+        auto const& f_v = face_vertices[f];
+        for (Index i = 0; i < 3; ++i)
+        {
+            Index const a = f_v[i];
+            Index const b = f_v[(i + 1) % 3];
+            Index const fi = static_cast<Index>(f);
+            half_edges.push_back((a < b) ? Vec4<Index>{a, b, fi, i} : Vec4<Index>{b, a, fi, i});
+        }
+    }
+
+    std::sort(half_edges.begin(), half_edges.end(), [](auto const& a, auto const& b) {
+        return (a[0] != b[0]) ? a[0] < b[0] : a[1] < b[1];
+    });
+
+    // Link pairs of half edges on the same edge
+    for (isize i = 0; i < size(half_edges);)
+    {
+        auto const& key = half_edges[i];
+
+        isize j = i + 1;
+        while (j < size(half_edges) && half_edges[j][0] == key[0] && half_edges[j][1] == key[1])
+            ++j;
+
+        if (j - i == 2)
+        {
+            auto const& other = half_edges[i + 1];
+            result[key[2]][key[3]] = other[2];
+            result[other[2]][other[3]] = key[2];
+        }
+
+        i = j;
+    }
+}
+
+/// Evaluates a per-vertex attribute (e.g. position) at points given by face and barycentric
+/// coordinates
+template <typename Real, typename Index, int dim>
+void eval_surface_points(
+    Span<Vec<Real, dim> const> const& vertex_attributes,
+    Span<Vec3<Index> const> const& face_vertices,
+    Span<Index const> const& point_faces,
+    Span<Vec3<Real> const> const& point_coords,
+    Span<Vec<Real, dim>> const& result)
+{
+    assert(point_faces.size() == point_coords.size());
+    assert(result.size() == point_faces.size());
+
+    for (isize i = 0; i < result.size(); ++i)
+    {
+        auto const& f_v = face_vertices[point_faces[i]];
+        auto const& w = point_coords[i];
+
+        result[i] = vertex_attributes[f_v[0]] * w[0] + vertex_attributes[f_v[1]] * w[1]
+            + vertex_attributes[f_v[2]] * w[2];
+    }
+}
+
+/// Computes the shortest distance from the given source vertices to each vertex along the edges of
+/// a mesh via Dijkstra's algorithm. Neighbors are given as by collect_vertex_neighbors along with
+/// the length of the edge to each. `heap` is scratch storage.
+template <typename Real, typename Index>
+void graph_distance(
+    Span<Index const> const& neighbor_offsets,
+    Span<Index const> const& neighbors,
+    Span<Real const> const& edge_lengths,
+    Span<Index const> const& sources,
+    Span<Real> const& result,
+    DynamicArray<std::pair<Real, Index>>& heap)
+{
+    using Entry = std::pair<Real, Index>;
+    auto const greater = [](Entry const& a, Entry const& b) { return a.first > b.first; };
+
+    for (auto& d : result)
+        d = std::numeric_limits<Real>::infinity();
+
+    heap.clear();
+    for (auto const v : sources)
+    {
+        result[v] = Real{0.0};
+        heap.push_back({Real{0.0}, v});
+    }
+
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        auto const [d, v] = heap.back();
+        heap.pop_back();
+
+        // Skip stale entries
+        if (d > result[v])
+            continue;
+
+        for (Index i = neighbor_offsets[v]; i < neighbor_offsets[v + 1]; ++i)
+        {
+            Index const w = neighbors[i];
+            Real const d_w = d + edge_lengths[i];
+
+            if (d_w < result[w])
+            {
+                result[w] = d_w;
+                heap.push_back({d_w, w});
+                std::push_heap(heap.begin(), heap.end(), greater);
+            }
+        }
+    }
+}
+
+} // namespace dr
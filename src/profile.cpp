@@ -0,0 +1,311 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+#include <dr/dynamic_array.hpp>
+
+namespace dr
+{
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// NOTE(dr): Older events are overwritten once a thread's log is full
+constexpr isize max_events = 4096;
+
+struct Event
+{
+    i64 start_ns;
+    i64 duration_ns;
+    u32 thread;
+    ProfileZone zone;
+};
+
+struct ZoneHistory
+{
+    f32 durations[profile_history_size];
+    i64 end_ns[profile_history_size];
+    isize head;
+    f32 max_ms;
+    i64 count;
+};
+
+/// Events recorded by a single thread
+struct ThreadLog
+{
+    // NOTE(dr): Only contended while the log is read or reset by another thread
+    std::mutex mutex;
+    u32 thread;
+    bool in_use;
+    Event events[max_events];
+    isize event_head;
+    isize event_count;
+    ZoneHistory zones[_ProfileZone_Count];
+};
+
+struct
+{
+    std::mutex mutex; // Guards the list of logs
+    Clock::time_point const epoch{Clock::now()};
+    DynamicArray<std::unique_ptr<ThreadLog>> logs;
+    u32 next_thread;
+    std::atomic<i64> counters[_ProfileCounter_Count];
+} state{};
+
+i64 now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(Clock::now() - state.epoch).count();
+}
+
+/// Owns a log for the lifetime of the calling thread. Logs are kept once their thread exits so
+/// that its events can still be read and are reused by later threads.
+struct ThreadLogHandle
+{
+    ThreadLog* log;
+
+    ThreadLogHandle()
+    {
+        std::lock_guard const lock{state.mutex};
+
+        auto const it = std::find_if(state.logs.begin(), state.logs.end(), [](auto const& log) {
+            return !log->in_use;
+        });
+
+        if (it != state.logs.end())
+        {
+            log = it->get();
+        }
+        else
+        {
+            state.logs.push_back(std::make_unique<ThreadLog>());
+            log = state.logs.back().get();
+        }
+
+        std::lock_guard const log_lock{log->mutex};
+        log->thread = state.next_thread++;
+        log->in_use = true;
+    }
+
+    ~ThreadLogHandle()
+    {
+        std::lock_guard const lock{state.mutex};
+        log->in_use = false;
+    }
+};
+
+ThreadLog& thread_log()
+{
+    thread_local ThreadLogHandle const handle{};
+    return *handle.log;
+}
+
+void record(ProfileZone const zone, i64 const start_ns, i64 const end_ns)
+{
+    ThreadLog& log = thread_log();
+
+    Event const event{start_ns, end_ns - start_ns, log.thread, zone};
+    f32 const duration_ms = event.duration_ns * 1.0e-6;
+
+    std::lock_guard const lock{log.mutex};
+
+    log.events[log.event_head] = event;
+    log.event_head = (log.event_head + 1) % max_events;
+    log.event_count = std::min(log.event_count + 1, max_events);
+
+    ZoneHistory& hist = log.zones[zone];
+    hist.durations[hist.head] = duration_ms;
+    hist.end_ns[hist.head] = end_ns;
+    hist.head = (hist.head + 1) % profile_history_size;
+    hist.max_ms = std::max(hist.max_ms, duration_ms);
+    ++hist.count;
+}
+
+} // namespace
+
+ProfileScope::ProfileScope(ProfileZone const zone) : zone_{zone}, start_{now_ns()} {}
+
+ProfileScope::~ProfileScope() { record(zone_, start_, now_ns()); }
+
+char const* profile_zone_name(ProfileZone const zone)
+{
+    static constexpr char const* names[]{
+        "HeatMethod::assemble",
+        "HeatMethod::decomp_distance",
+        "HeatMethod::decomp_heat",
+        "HeatMethod::solve_heat",
+        "HeatMethod::divergence",
+        "HeatMethod::solve_poisson",
+        "LoadMeshAsset",
+        "ApproximateDistance",
+        "SolveDistance",
+        "extract_isolines",
+        "RenderMesh::upload_indices",
+        "RenderMesh::upload_vertices",
+    };
+    static_assert(size(names) == _ProfileZone_Count);
+    return names[zone];
+}
+
+char const* profile_counter_name(ProfileCounter const counter)
+{
+    static constexpr char const* names[]{
+        "Solves",
+        "Time retries",
+        "Uploaded bytes",
+    };
+    static_assert(size(names) == _ProfileCounter_Count);
+    return names[counter];
+}
+
+void profile_count(ProfileCounter const counter, i64 const amount)
+{
+    state.counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+i64 get_profile_count(ProfileCounter const counter)
+{
+    return state.counters[counter].load(std::memory_order_relaxed);
+}
+
+void get_profile_stats(ProfileZone const zone, ProfileZoneStats& result)
+{
+    struct Entry
+    {
+        i64 end_ns;
+        f32 duration_ms;
+    };
+
+    // Merge the recent durations of each thread in the order they ended
+    Entry entries[profile_history_size];
+    isize num_entries = 0;
+
+    result.max_ms = 0.0f;
+    result.count = 0;
+
+    std::lock_guard const lock{state.mutex};
+
+    for (auto const& log : state.logs)
+    {
+        std::lock_guard const log_lock{log->mutex};
+        ZoneHistory const& hist = log->zones[zone];
+
+        isize const n = std::min(hist.count, i64{profile_history_size});
+        for (isize i = profile_history_size - n; i < profile_history_size; ++i)
+        {
+            isize const j = (hist.head + i) % profile_history_size;
+            Entry const entry{hist.end_ns[j], hist.durations[j]};
+
+            // Replace the oldest entry once full
+            if (num_entries < profile_history_size)
+            {
+                entries[num_entries++] = entry;
+            }
+            else
+            {
+                Entry* const oldest = std::min_element(
+                    entries,
+                    entries + num_entries,
+                    [](Entry const& a, Entry const& b) { return a.end_ns < b.end_ns; });
+
+                if (oldest->end_ns < entry.end_ns)
+                    *oldest = entry;
+            }
+        }
+
+        result.max_ms = std::max(result.max_ms, hist.max_ms);
+        result.count += hist.count;
+    }
+
+    std::sort(entries, entries + num_entries, [](Entry const& a, Entry const& b) {
+        return a.end_ns < b.end_ns;
+    });
+
+    // Durations are right aligned such that the most recent is always last
+    isize const offset = profile_history_size - num_entries;
+    std::fill(result.history, result.history + offset, 0.0f);
+
+    for (isize i = 0; i < num_entries; ++i)
+        result.history[offset + i] = entries[i].duration_ms;
+}
+
+bool write_profile_trace(char const* const path)
+{
+    // Copy events so locks aren't held during IO
+    DynamicArray<Event> events{};
+    {
+        std::lock_guard const lock{state.mutex};
+
+        for (auto const& log : state.logs)
+        {
+            std::lock_guard const log_lock{log->mutex};
+            isize const num_events = log->event_count;
+
+            isize const first = (log->event_head - num_events + max_events) % max_events;
+            for (isize i = 0; i < num_events; ++i)
+                events.push_back(log->events[(first + i) % max_events]);
+        }
+    }
+
+    FILE* const file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    i64 end_ns = 0;
+    for (Event const& e : events)
+    {
+        std::fprintf(
+            file,
+            "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+            profile_zone_name(e.zone),
+            e.thread,
+            e.start_ns * 1.0e-3,
+            e.duration_ns * 1.0e-3);
+
+        end_ns = std::max(end_ns, e.start_ns + e.duration_ns);
+    }
+
+    // Counter totals are reported at the end of the trace
+    for (u8 i = 0; i < _ProfileCounter_Count; ++i)
+    {
+        ProfileCounter const counter{i};
+        std::fprintf(
+            file,
+            "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"value\":%lld}}%s\n",
+            profile_counter_name(counter),
+            end_ns * 1.0e-3,
+            static_cast<long long>(get_profile_count(counter)),
+            (i + 1 < _ProfileCounter_Count) ? "," : "");
+    }
+
+    std::fprintf(file, "]}\n");
+    return std::fclose(file) == 0;
+}
+
+void reset_profile()
+{
+    std::lock_guard const lock{state.mutex};
+
+    for (auto const& log : state.logs)
+    {
+        std::lock_guard const log_lock{log->mutex};
+        log->event_head = 0;
+        log->event_count = 0;
+
+        for (auto& hist : log->zones)
+            hist = {};
+    }
+
+    for (auto& counter : state.counters)
+        counter.store(0, std::memory_order_relaxed);
+}
+
+} // namespace dr
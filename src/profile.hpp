@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+    Lightweight instrumentation of hot paths. Scoped timers record into a fixed-size log of recent
+    events (exportable as a Chrome trace) along with a rolling history of durations per zone.
+    Recording is thread safe. Each thread records into its own log so concurrent scopes (e.g.
+    solves sharing a HeatMethod) don't contend with each other.
+*/
+
+#include <dr/basic_types.hpp>
+
+namespace dr
+{
+
+enum ProfileZone : u8
+{
+    ProfileZone_HeatMethodAssemble = 0,
+    ProfileZone_HeatMethodDecompDistance,
+    ProfileZone_HeatMethodDecompHeat,
+    ProfileZone_HeatMethodSolveHeat,
+    ProfileZone_HeatMethodDivergence,
+    ProfileZone_HeatMethodSolvePoisson,
+    ProfileZone_LoadMeshAsset,
+    ProfileZone_ApproximateDistance,
+    ProfileZone_SolveDistance,
+    ProfileZone_ExtractIsolines,
+    ProfileZone_UploadIndices,
+    ProfileZone_UploadVertices,
+    _ProfileZone_Count,
+};
+
+enum ProfileCounter : u8
+{
+    ProfileCounter_Solves = 0,
+    ProfileCounter_TimeRetries,
+    ProfileCounter_UploadBytes,
+    _ProfileCounter_Count,
+};
+
+/// Number of recent durations kept per zone
+constexpr isize profile_history_size = 64;
+
+struct ProfileZoneStats
+{
+    f32 history[profile_history_size]; // Durations in ms, oldest first
+    f32 max_ms;
+    i64 count;
+};
+
+/// Records the duration of the enclosing scope
+struct ProfileScope
+{
+    explicit ProfileScope(ProfileZone zone);
+    ~ProfileScope();
+
+    ProfileScope(ProfileScope const&) = delete;
+    ProfileScope& operator=(ProfileScope const&) = delete;
+
+  private:
+    ProfileZone zone_;
+    i64 start_;
+};
+
+char const* profile_zone_name(ProfileZone zone);
+
+char const* profile_counter_name(ProfileCounter counter);
+
+void profile_count(ProfileCounter counter, i64 amount = 1);
+
+i64 get_profile_count(ProfileCounter counter);
+
+void get_profile_stats(ProfileZone zone, ProfileZoneStats& result);
+
+/// Writes recent events in the Chrome trace event format (viewable via chrome://tracing or
+/// https://ui.perfetto.dev)
+bool write_profile_trace(char const* path);
+
+void reset_profile();
+
+} // namespace dr
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+    Quantization of scalar fields (e.g. distance) to normalized 16-bit integers for compact
+    transport
+*/
+
+#include <cassert>
+#include <cmath>
+
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+
+namespace dr
+{
+
+/// Maps values in [0, max_value] to the full range of u16 by rounding to the nearest step. Values
+/// outside the range are clamped. The largest error after dequantizing is max_value / 131070.
+template <typename Real>
+void quantize_unorm16(
+    Span<Real const> const& values,
+    Real const max_value,
+    Span<u16> const& result)
+{
+    assert(values.size() == result.size());
+    assert(max_value > Real{0.0});
+
+    Real const scale = Real{65535.0} / max_value;
+    for (isize i = 0; i < values.size(); ++i)
+    {
+        Real const x = clamp(values[i] * scale, Real{0.0}, Real{65535.0});
+        result[i] = static_cast<u16>(std::lround(x));
+    }
+}
+
+/// Inverse of quantize_unorm16
+template <typename Real>
+void dequantize_unorm16(
+    Span<u16 const> const& values,
+    Real const max_value,
+    Span<Real> const& result)
+{
+    assert(values.size() == result.size());
+
+    Real const scale = max_value / Real{65535.0};
+    for (isize i = 0; i < values.size(); ++i)
+        result[i] = values[i] * scale;
+}
+
+} // namespace dr
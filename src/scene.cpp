@@ -1,10 +1,13 @@
 #include "scene.hpp"
 
+#include <cfloat>
 #include <cmath>
+#include <cstdio>
 
 #include <sokol_gl.h>
 #include <sokol_time.h>
 
+#include <dr/linalg_reshape.hpp>
 #include <dr/math.hpp>
 #include <dr/random.hpp>
 #include <dr/span.hpp>
@@ -19,6 +22,11 @@
 
 #include "assets.hpp"
 #include "graphics.hpp"
+#include "isolines.hpp"
+#include "memory_stats.hpp"
+#include "mesh_io.hpp"
+#include "mesh_utils.hpp"
+#include "profile.hpp"
 #include "tasks.hpp"
 
 namespace dr
@@ -55,6 +63,9 @@ struct {
 struct {
     struct {
         RenderMesh mesh;
+        isize lod;
+        DynamicArray<Vec2<i32>> visible_faces; // Ranges of faces in unculled clusters
+        isize num_visible_clusters;
         struct {
             ContourColor contour_color;
             ContourLine contour_line;
@@ -69,8 +80,26 @@ struct {
     TaskQueue task_queue;
     struct {
         LoadMeshAsset load_mesh_asset;
+        ApproximateDistance approximate_distance;
         SolveDistance solve_distance;
     } tasks;
+    bool distance_is_approximate;
+
+    struct {
+        Isolines<f32, i32> lines;
+        IsolineWorkspace<i32> workspace;
+        DynamicArray<f32> distance; // Copy of the distance field being contoured
+        DynamicArray<f32> isovalues;
+        DynamicArray<Vec3<f32>> points;
+        f32 spacing;
+        f32 offset;
+        bool is_stale;
+    } isolines;
+
+    struct {
+        HeatMethodStats solver;
+        usize workspace_bytes;
+    } stats;
 
     struct {
         f32 fov_y{deg_to_rad(60.0f)};
@@ -91,14 +120,22 @@ struct {
     
     struct {
         AssetHandle::Mesh mesh_handle;
+        Param<i32> refine_level{0, 0, AssetHandle::max_mesh_refine_level};
         DisplayMode display_mode;
+        BoundaryCondition boundary_condition{BoundaryCondition_Averaged};
+        SolveDistance::Method solve_method{SolveDistance::Method_Direct};
         Param<i32> num_sources{1, 1, 10};
-        Param<f32> solve_time{0.002f, 0.001f, 0.01f};
+        Param<f32> time_scale{1.0f, 0.1f, 10.0f};
         Param<f32> contour_spacing{0.1f, 0.0f, 1.0f};
         Param<f32> contour_width{0.3f, 0.0f, 1.0f};
         Param<f32> contour_speed{0.1f, 0.0f, 1.0f};
         Param<f32> contour_offset{0.0f, 0.0f, 1.0f};
+        Param<f32> lod_error{1.0f, 0.0f, 8.0f}; // In pixels
         bool animate{true};
+        bool cull_clusters{true};
+        bool progressive{true};
+        bool reorder_mesh{true};
+        bool show_isolines;
     } params;
 } state{};
 // clang-format on
@@ -125,9 +162,19 @@ void reset_source_vertices()
         src_verts[i] = state.random_vertex();
 }
 
+/// Sets the distance field from which isolines are extracted
+void set_isoline_distance(Span<f32 const> const& distance)
+{
+    // NOTE(dr): Distance is copied since task outputs are overwritten by the next solve which may
+    // be in flight while isolines are extracted
+    state.isolines.distance.assign(distance.begin(), distance.end());
+    state.isolines.is_stale = true;
+}
+
 void set_mesh(MeshAsset const* mesh)
 {
     state.mesh = mesh;
+    set_isoline_distance({});
 
     // Initialize source vertices
     {
@@ -139,7 +186,10 @@ void set_mesh(MeshAsset const* mesh)
     // Update the render mesh
     {
         auto& render_mesh = state.gfx.mesh;
-        render_mesh.set_indices(as_span(mesh->faces.vertex_ids));
+        render_mesh.set_indices(
+            as_span(mesh->faces.vertex_ids),
+            as_span(mesh->lods.vertex_ids).as_const(),
+            as_span(mesh->lods.offsets).as_const());
         render_mesh.set_vertices(
             as_span(mesh->vertices.positions),
             as_span(mesh->vertices.normals));
@@ -162,12 +212,19 @@ void schedule_task(SolveDistance& task)
                 task->input.mesh = state.mesh;
                 task->input.source_vertices = //
                     as_span(state.source_vertices).front(state.params.num_sources.value);
+                task->input.time_scale = state.params.time_scale.value;
+                task->input.boundary_condition = state.params.boundary_condition;
+                task->input.method = state.params.solve_method;
 
                 return true;
             };
             case Event::AfterComplete:
             {
                 state.gfx.mesh.set_vertices(task->output.distance);
+                set_isoline_distance(task->output.distance);
+                state.distance_is_approximate = false;
+                state.stats.solver = task->output.stats;
+                state.stats.workspace_bytes = task->output.workspace_bytes;
                 return true;
             };
             default:
@@ -178,6 +235,51 @@ void schedule_task(SolveDistance& task)
     });
 }
 
+void schedule_task(ApproximateDistance& task)
+{
+    using Event = TaskQueue::PollEvent;
+
+    state.task_queue.push(&task, nullptr, [](Event const& event) -> bool {
+        auto const task = static_cast<ApproximateDistance*>(event.task);
+        switch (event.type)
+        {
+            case Event::BeforeSubmit:
+            {
+                task->input.mesh = state.mesh;
+                task->input.source_vertices = //
+                    as_span(state.source_vertices).front(state.params.num_sources.value);
+
+                state.distance_is_approximate = true;
+                return true;
+            };
+            case Event::AfterComplete:
+            {
+                // NOTE(dr): Don't replace the full solution if it completed first
+                if (state.distance_is_approximate)
+                {
+                    state.gfx.mesh.set_vertices(task->output.distance);
+                    set_isoline_distance(task->output.distance);
+                }
+
+                return true;
+            };
+            default:
+            {
+                return true;
+            };
+        }
+    });
+}
+
+/// Schedules a solve for distance which is preceded by a cheap approximation in progressive mode
+void schedule_solve()
+{
+    if (state.params.progressive)
+        schedule_task(state.tasks.approximate_distance);
+
+    schedule_task(state.tasks.solve_distance);
+}
+
 void schedule_task(LoadMeshAsset& task)
 {
     using Event = TaskQueue::PollEvent;
@@ -189,6 +291,8 @@ void schedule_task(LoadMeshAsset& task)
             case Event::BeforeSubmit:
             {
                 task->input.handle = state.params.mesh_handle;
+                task->input.refine_level = state.params.refine_level.value;
+                task->input.reorder = state.params.reorder_mesh;
                 return true;
             };
             case Event::AfterComplete:
@@ -219,7 +323,11 @@ void draw_settings_tab()
                 "Chen-Gackstatter",
                 "Node cluster",
                 "Armadillo",
+                "Icosphere",
+                "Ring torus",
+                "Genus 5",
             };
+            static_assert(size(mesh_names) == AssetHandle::_Mesh_Count);
 
             AssetHandle::Mesh const handle = state.params.mesh_handle;
             if (ImGui::BeginCombo("Shape", mesh_names[handle]))
@@ -234,7 +342,7 @@ void draw_settings_tab()
                             state.params.mesh_handle = AssetHandle::Mesh{i};
                             schedule_task(state.tasks.load_mesh_asset);
                             state.task_queue.barrier();
-                            schedule_task(state.tasks.solve_distance);
+                            schedule_solve();
                         }
                     }
 
@@ -245,6 +353,28 @@ void draw_settings_tab()
                 ImGui::EndCombo();
             }
 
+            {
+                // NOTE(dr): Changes are only committed to global state on mouse up
+                Param<i32>& p = state.params.refine_level;
+                static i32 value = p.value;
+
+                ImGui::SliderInt("Refinement", &value, p.min, p.max);
+                if (ImGui::IsItemDeactivatedAfterEdit() && value != p.value)
+                {
+                    p.value = value;
+                    schedule_task(state.tasks.load_mesh_asset);
+                    state.task_queue.barrier();
+                    schedule_solve();
+                }
+            }
+
+            if (ImGui::Checkbox("Reorder for locality", &state.params.reorder_mesh))
+            {
+                schedule_task(state.tasks.load_mesh_asset);
+                state.task_queue.barrier();
+                schedule_solve();
+            }
+
             {
                 // NOTE(dr): Changes are only committed to global state on mouse up
                 Param<i32>& p = state.params.num_sources;
@@ -255,10 +385,92 @@ void draw_settings_tab()
                 {
                     state.params.num_sources.value = value;
                     append_source_vertices();
-                    schedule_task(state.tasks.solve_distance);
+                    schedule_solve();
                 }
             }
 
+            {
+                // NOTE(dr): Changes are only committed to global state on mouse up
+                Param<f32>& p = state.params.time_scale;
+                static f32 value = p.value;
+
+                ImGui::SliderFloat(
+                    "Time scale",
+                    &value,
+                    p.min,
+                    p.max,
+                    "%.2f",
+                    ImGuiSliderFlags_Logarithmic);
+
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                {
+                    state.params.time_scale.value = value;
+                    schedule_solve();
+                }
+            }
+
+            {
+                static char const* const bc_names[_BoundaryCondition_Count]{
+                    "Neumann",
+                    "Dirichlet",
+                    "Averaged",
+                };
+
+                BoundaryCondition const bc = state.params.boundary_condition;
+                if (ImGui::BeginCombo("Boundary", bc_names[bc]))
+                {
+                    for (u8 i = 0; i < _BoundaryCondition_Count; ++i)
+                    {
+                        bool const is_selected = (i == bc);
+                        if (ImGui::Selectable(bc_names[i], is_selected))
+                        {
+                            if (!is_selected)
+                            {
+                                state.params.boundary_condition = BoundaryCondition{i};
+                                schedule_solve();
+                            }
+                        }
+
+                        if (is_selected)
+                            ImGui::SetItemDefaultFocus();
+                    }
+
+                    ImGui::EndCombo();
+                }
+            }
+
+            {
+                static char const* const method_names[SolveDistance::_Method_Count]{
+                    "Direct",
+                    "Iterative (low memory)",
+                    "Multigrid (large meshes)",
+                };
+
+                SolveDistance::Method const method = state.params.solve_method;
+                if (ImGui::BeginCombo("Solver", method_names[method]))
+                {
+                    for (u8 i = 0; i < SolveDistance::_Method_Count; ++i)
+                    {
+                        bool const is_selected = (i == method);
+                        if (ImGui::Selectable(method_names[i], is_selected))
+                        {
+                            if (!is_selected)
+                            {
+                                state.params.solve_method = SolveDistance::Method{i};
+                                schedule_solve();
+                            }
+                        }
+
+                        if (is_selected)
+                            ImGui::SetItemDefaultFocus();
+                    }
+
+                    ImGui::EndCombo();
+                }
+            }
+
+            ImGui::Checkbox("Show approximation first", &state.params.progressive);
+
             {
                 char const* label = (state.params.num_sources.value > 1) //
                     ? "Change sources"
@@ -267,7 +479,7 @@ void draw_settings_tab()
                 if (ImGui::Button(label))
                 {
                     reset_source_vertices();
-                    schedule_task(state.tasks.solve_distance);
+                    schedule_solve();
                 }
             }
 
@@ -327,6 +539,62 @@ void draw_settings_tab()
             }
 
             ImGui::Checkbox("Animate", &state.params.animate);
+
+            {
+                Param<f32>& p = state.params.lod_error;
+                ImGui::SliderFloat("Detail error (px)", &p.value, p.min, p.max, "%.1f");
+            }
+
+            ImGui::Checkbox("Cull clusters", &state.params.cull_clusters);
+            ImGui::Checkbox("Show isolines", &state.params.show_isolines);
+        }
+        ImGui::Spacing();
+
+        ImGui::SeparatorText("Stats");
+        {
+            auto const to_mb = [](usize const bytes) -> f64 { return bytes / (1024.0 * 1024.0); };
+            ImGui::Text("Peak memory: %.1f MB", to_mb(peak_memory_bytes()));
+
+            if (state.mesh)
+            {
+                ImGui::Text(
+                    "Mesh: %.2f MB (%td vertices, %td faces)",
+                    to_mb(memory_bytes(*state.mesh)),
+                    state.mesh->vertices.count(),
+                    state.mesh->faces.count());
+
+                auto const& offsets = state.gfx.mesh.index_offsets;
+                isize const lod = state.gfx.lod;
+                ImGui::Text(
+                    "Level of detail: %td of %td (%d faces)",
+                    lod,
+                    state.gfx.mesh.num_lods() - 1,
+                    (offsets[lod + 1] - offsets[lod]) / 3);
+
+                if (lod == 0 && state.params.cull_clusters)
+                {
+                    ImGui::Text(
+                        "Visible clusters: %td of %td",
+                        state.gfx.num_visible_clusters,
+                        state.mesh->clusters.count());
+                }
+            }
+
+            if (ImGui::TreeNode("Solver"))
+            {
+                HeatMethodStats const& st = state.stats.solver;
+                ImGui::Text("Matrices: %.2f MB", to_mb(st.matrix_bytes));
+                ImGui::Text("Factors: %.2f MB", to_mb(st.factor_bytes));
+                ImGui::Text("Buffers: %.2f MB", to_mb(st.buffer_bytes));
+                ImGui::Text("Workspace: %.2f MB", to_mb(state.stats.workspace_bytes));
+                ImGui::Text("Nonzeros in S, A: %td, %td", st.nnz_stiffness, st.nnz_heat);
+                ImGui::Text(
+                    "Nonzeros in L (heat, Dirichlet, distance): %td, %td, %td",
+                    st.nnz_heat_factor,
+                    st.nnz_heat_dirichlet_factor,
+                    st.nnz_distance_factor);
+                ImGui::TreePop();
+            }
         }
         ImGui::Spacing();
 
@@ -334,6 +602,77 @@ void draw_settings_tab()
     }
 }
 
+void draw_profile_tab()
+{
+    if (ImGui::BeginTabItem("Profile"))
+    {
+        ImGui::SeparatorText("Timings");
+        {
+            ProfileZoneStats stats;
+            for (u8 i = 0; i < _ProfileZone_Count; ++i)
+            {
+                ProfileZone const zone{i};
+                get_profile_stats(zone, stats);
+
+                if (stats.count == 0)
+                    continue;
+
+                char overlay[48];
+                std::snprintf(
+                    overlay,
+                    size(overlay),
+                    "%.2f ms (max %.2f ms)",
+                    stats.history[profile_history_size - 1],
+                    stats.max_ms);
+
+                ImGui::PlotHistogram(
+                    profile_zone_name(zone),
+                    stats.history,
+                    profile_history_size,
+                    0,
+                    overlay,
+                    0.0f,
+                    FLT_MAX,
+                    {0.0f, 40.0f});
+            }
+        }
+        ImGui::Spacing();
+
+        ImGui::SeparatorText("Counters");
+        for (u8 i = 0; i < _ProfileCounter_Count; ++i)
+        {
+            ProfileCounter const counter{i};
+            ImGui::Text(
+                "%s: %lld",
+                profile_counter_name(counter),
+                static_cast<long long>(get_profile_count(counter)));
+        }
+        ImGui::Spacing();
+
+        if (ImGui::Button("Reset"))
+            reset_profile();
+
+#if !__EMSCRIPTEN__
+        {
+            static char const* status = "";
+
+            ImGui::SameLine();
+            if (ImGui::Button("Export trace"))
+            {
+                bool const ok = write_profile_trace("trace.json");
+                status = ok ? "Saved to trace.json" : "Export failed";
+            }
+
+            ImGui::SameLine();
+            ImGui::Text("%s", status);
+        }
+#endif
+        ImGui::Spacing();
+
+        ImGui::EndTabItem();
+    }
+}
+
 void draw_about_tab()
 {
     if (ImGui::BeginTabItem("About"))
@@ -383,6 +722,7 @@ void draw_main_window()
     if (ImGui::BeginTabBar("TabBar", ImGuiTabBarFlags_None))
     {
         draw_settings_tab();
+        draw_profile_tab();
         draw_about_tab();
         ImGui::EndTabBar();
     }
@@ -443,6 +783,85 @@ void debug_draw_source_normals(Mat4<f32> const& local_to_view)
     sgl_end();
 }
 
+/// Extracts isolines at the current contour spacing if they're out of date
+void update_isolines()
+{
+    auto& iso = state.isolines;
+    f32 const spacing = state.params.contour_spacing.value;
+    f32 const offset = state.params.contour_offset.value;
+
+    if (!iso.is_stale && iso.spacing == spacing && iso.offset == offset)
+        return;
+
+    iso.spacing = spacing;
+    iso.offset = offset;
+    iso.is_stale = false;
+
+    // Isovalues are placed where the contour shaders draw lines i.e. where (d + offset) / spacing
+    // is an integer. They don't follow the animated offset since extraction isn't done per frame.
+    constexpr isize max_isovalues = 1024;
+    iso.isovalues.clear();
+
+    if (size(iso.distance) > 0 && spacing > 0.0f)
+    {
+        f32 const max_dist = as_vec(as_span(iso.distance)).maxCoeff();
+        f32 value = (std::floor(offset / spacing) + 1.0f) * spacing - offset;
+
+        for (; value <= max_dist && size(iso.isovalues) < max_isovalues; value += spacing)
+            iso.isovalues.push_back(value);
+    }
+
+    auto const face_verts = as_span(state.mesh->faces.vertex_ids).as_const();
+    extract_isolines(
+        face_verts,
+        as_span(iso.distance).as_const(),
+        as_span(iso.isovalues).as_const(),
+        iso.lines,
+        iso.workspace);
+
+    iso.points.resize(iso.lines.num_points());
+    eval_surface_points(
+        as_span(state.mesh->vertices.positions).as_const(),
+        face_verts,
+        as_span(iso.lines.point_faces).as_const(),
+        as_span(iso.lines.point_coords).as_const(),
+        as_span(iso.points));
+}
+
+void debug_draw_isolines(Mat4<f32> const& local_to_view)
+{
+    sgl_matrix_mode_modelview();
+    sgl_load_matrix(local_to_view.data());
+
+    // NOTE(dr): sokol_gl has a fixed vertex budget per frame so very dense isolines may be
+    // truncated
+    sgl_begin_lines();
+    sgl_c3f(1.0f, 0.6f, 0.2f);
+
+    auto const& lines = state.isolines.lines;
+    auto const& points = state.isolines.points;
+
+    for (isize i = 0; i < lines.count(); ++i)
+    {
+        i32 const start = lines.offsets[i];
+        i32 const end = lines.offsets[i + 1];
+
+        for (i32 j = start; j < end; ++j)
+        {
+            i32 const k = (j + 1 < end) ? j + 1 : start;
+            if (k == start && !lines.is_closed[i])
+                break;
+
+            auto const& p0 = points[j];
+            auto const& p1 = points[k];
+            sgl_v3f(p0.x(), p0.y(), p0.z());
+            sgl_v3f(p1.x(), p1.y(), p1.z());
+        }
+    }
+
+    sgl_end();
+}
+
 void draw_debug(
     Mat4<f32> const& world_to_view,
     Mat4<f32> const& local_to_view,
@@ -456,8 +875,16 @@ void draw_debug(
     debug_draw_axes(world_to_view, 0.1f);
 
     if (state.mesh)
+    {
         debug_draw_source_normals(local_to_view);
 
+        if (state.params.show_isolines)
+        {
+            update_isolines();
+            debug_draw_isolines(local_to_view);
+        }
+    }
+
     sgl_draw();
 }
 
@@ -470,7 +897,7 @@ void open(void* /*context*/)
     {
         schedule_task(state.tasks.load_mesh_asset);
         state.task_queue.barrier();
-        schedule_task(state.tasks.solve_distance);
+        schedule_solve();
     }
 
     center_camera();
@@ -501,6 +928,100 @@ void update(void* /*context*/)
     state.task_queue.poll();
 }
 
+/// Returns the coarsest level of detail whose geometric error projects to within the given number
+/// of pixels on screen
+isize select_lod(Mat4<f32> const& world_to_view, f32 const max_error)
+{
+    auto const& mesh = *state.mesh;
+    if (max_error <= 0.0f)
+        return 0;
+
+    // NOTE(dr): The mesh is fit to the unit sphere at the world origin (see draw) so the nearest
+    // point on its bounds is conservative for every face
+    f32 const eye_dist = world_to_view.col(3).head<3>().norm();
+    f32 const dist = max(eye_dist - 1.0f, state.view.clip_near);
+    f32 const px_per_unit = 1.0f / (dist * screen_to_view(state.view.fov_y, sapp_heightf()));
+    f32 const local_to_px = px_per_unit / mesh.bounds.radius;
+
+    for (isize i = state.gfx.mesh.num_lods() - 1; i > 0; --i)
+    {
+        if (mesh.lods.errors[i - 1] * local_to_px <= max_error)
+            return i;
+    }
+
+    return 0;
+}
+
+/// Collects the ranges of faces in clusters that intersect the view frustum and face the camera.
+/// Ranges of adjacent clusters are merged into one.
+void cull_clusters(
+    Mat4<f32> const& local_to_view,
+    Mat4<f32> const& view_to_clip,
+    DynamicArray<Vec2<i32>>& result)
+{
+    auto const& clusters = state.mesh->clusters;
+    result.clear();
+    state.gfx.num_visible_clusters = 0;
+
+    // Extract frustum planes in local space (Gribb & Hartmann)
+    Vec4<f32> planes[6];
+    {
+        Mat4<f32> const local_to_clip = view_to_clip * local_to_view;
+        Vec4<f32> const w = local_to_clip.row(3).transpose();
+
+        for (int i = 0; i < 3; ++i)
+        {
+            Vec4<f32> const r = local_to_clip.row(i).transpose();
+            planes[2 * i] = w + r;
+            planes[2 * i + 1] = w - r;
+        }
+
+        for (auto& p : planes)
+            p /= p.head<3>().norm();
+    }
+
+    Vec3<f32> const eye = local_to_view.inverse().col(3).head<3>();
+
+    for (isize i = 0; i < clusters.count(); ++i)
+    {
+        Vec3<f32> const center = clusters.spheres.col(i).head<3>();
+        f32 const radius = clusters.spheres(3, i);
+
+        bool is_visible = true;
+        for (auto const& p : planes)
+        {
+            if (p.head<3>().dot(center) + p[3] < -radius)
+            {
+                is_visible = false;
+                break;
+            }
+        }
+
+        // NOTE(dr): Culls the cluster if every point in its bounding sphere sees the back of every
+        // face in its normal cone
+        if (is_visible)
+        {
+            Vec3<f32> const d = center - eye;
+            Vec3<f32> const axis = clusters.cones.col(i).head<3>();
+            f32 const sin_angle = clusters.cones(3, i);
+            is_visible = d.dot(axis) <= sin_angle * d.norm() + radius;
+        }
+
+        if (is_visible)
+        {
+            i32 const start = clusters.offsets[i];
+            i32 const end = clusters.offsets[i + 1];
+
+            if (!result.empty() && result.back()[1] == start)
+                result.back()[1] = end;
+            else
+                result.push_back({start, end});
+
+            ++state.gfx.num_visible_clusters;
+        }
+    }
+}
+
 void draw(void* /*context*/)
 {
     constexpr auto make_local_to_world = []() -> Mat4<f32> {
@@ -542,7 +1063,7 @@ void draw(void* /*context*/)
             case DisplayMode_ContourColor:
             {
                 auto& mat = state.gfx.materials.contour_color;
-                sg_apply_pipeline(mat.pipeline());
+                sg_apply_pipeline(mat.pipeline(state.gfx.mesh.index_type));
                 mat.bind_resources(bindings);
 
                 // Update uniforms
@@ -556,7 +1077,7 @@ void draw(void* /*context*/)
             case DisplayMode_ContourLine:
             {
                 auto& mat = state.gfx.materials.contour_line;
-                sg_apply_pipeline(mat.pipeline());
+                sg_apply_pipeline(mat.pipeline(state.gfx.mesh.index_type));
                 mat.bind_resources(bindings);
 
                 // Update uniforms
@@ -577,7 +1098,21 @@ void draw(void* /*context*/)
         auto const& geom = state.gfx.mesh;
         geom.bind_resources(bindings);
         sg_apply_bindings(bindings);
-        geom.dispatch_draw();
+
+        state.gfx.lod = select_lod(world_to_view, state.params.lod_error.value);
+
+        if (state.gfx.lod == 0 && state.params.cull_clusters)
+        {
+            auto& ranges = state.gfx.visible_faces;
+            cull_clusters(local_to_view, view_to_clip, ranges);
+
+            for (auto const& r : ranges)
+                geom.dispatch_draw_faces(r[0], r[1] - r[0]);
+        }
+        else
+        {
+            geom.dispatch_draw(state.gfx.lod);
+        }
     }
 
     draw_debug(world_to_view, local_to_view, view_to_clip);
@@ -0,0 +1,845 @@
+/*
+    Serves geodesic distance queries to other processes on the same machine over a Unix domain
+    socket. Meshes stay loaded along with their factorized solvers so each query only pays for the
+    solve itself. Distance is written straight into shared memory mapped by the client rather than
+    sent over the socket.
+
+    Each request is a header of four u32 "<type> <mesh> <slot> <count>" in native byte order
+    followed by a payload whose size depends on the type
+
+    - Load (type 0): Loads the PLY mesh whose path is given by the payload (count bytes without a
+      terminator) and allocates `slot` result arrays in shared memory. Mesh is ignored. Loading the
+      same path again returns the existing mesh.
+    - Solve (type 1): Computes distance on the given mesh from the source vertices (file order)
+      given by the payload (count i32) and writes it to the given slot as one f32 per vertex in
+      file order.
+
+    Each request gets a 64 byte response of four u32 "<status> <mesh> <slot> <num vertices>"
+    followed by the null terminated name of the mesh's shared memory object. Slot i of a mesh
+    starts at byte i * num_vertices * 4 of its shared memory. Status is nonzero if the request
+    failed (1 = bad request, 2 = failed to load, 3 = failed to solve).
+
+    Requests are handled in batches. Everything received since the last batch is read before any
+    solves are run, and solves from the same batch run in parallel against each mesh's shared
+    solver. Responses are sent in request order once the batch completes. Slots are chosen by
+    clients so requests in flight at the same time should use different ones.
+
+    Usage
+    geodesic-heat-server <socket path> [-t <time scale>] [--time <time>] [-j <threads>]
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+#include <dr/string.hpp>
+
+#include "diffusion_time.hpp"
+#include "heat_method.hpp"
+#include "mesh_io.hpp"
+
+namespace dr
+{
+namespace
+{
+
+// Limits on the payload of a request. Anything larger is treated as a broken stream.
+constexpr u32 max_path_size = 4096;
+constexpr u32 max_num_sources = 1u << 24;
+
+constexpr u32 max_num_slots = 1024;
+
+// NOTE(dr): Requests from a client aren't read while this many bytes of responses are waiting to
+// be sent to it, i.e. clients that stop reading are throttled rather than buffered for
+constexpr usize max_pending_send = 1 << 20;
+
+enum RequestType : u32
+{
+    RequestType_Load = 0,
+    RequestType_Solve,
+    _RequestType_Count,
+};
+
+enum Status : u32
+{
+    Status_Ok = 0,
+    Status_BadRequest,
+    Status_LoadFailed,
+    Status_SolveFailed,
+};
+
+struct RequestHeader
+{
+    u32 type;
+    u32 mesh;
+    u32 slot;
+    u32 count;
+};
+
+struct Response
+{
+    u32 status;
+    u32 mesh;
+    u32 slot;
+    u32 num_vertices;
+    char shm_name[48];
+};
+
+static_assert(sizeof(RequestHeader) == 16);
+static_assert(sizeof(Response) == 64);
+
+struct Config
+{
+    char const* socket_path{};
+    f32 time_scale{1.0f};
+    f32 time{}; // Overrides time_scale if positive
+    isize num_threads{};
+};
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+struct ServedMesh
+{
+    using Solver = HeatMethod<f32, i32>;
+
+    /// State of a query on a single thread
+    struct Worker
+    {
+        Solver::Workspace workspace{};
+        DynamicArray<i32> sources{};
+        DynamicArray<f32> distance{};
+    };
+
+    String path{};
+    MeshAsset mesh{};
+    Solver solver{};
+    DynamicArray<i32> vert_index{}; // Solver index of each vertex in file order
+    DynamicArray<Worker> workers{}; // One per thread
+    f32 time{};
+    i32 num_retries{};
+
+    char shm_name[sizeof(Response::shm_name)]{};
+    f32* results{}; // Shared memory holding each slot
+    isize num_slots{};
+
+    ServedMesh() = default;
+    ServedMesh(ServedMesh const&) = delete;
+    ServedMesh& operator=(ServedMesh const&) = delete;
+
+    ~ServedMesh()
+    {
+        if (results)
+        {
+            munmap(results, shm_size());
+            shm_unlink(shm_name);
+        }
+    }
+
+    isize num_vertices() const { return mesh.vertices.count(); }
+
+    usize shm_size() const { return sizeof(f32) * num_slots * num_vertices(); }
+
+    Span<f32> slot(isize const index) const
+    {
+        return {results + index * num_vertices(), num_vertices()};
+    }
+};
+
+/// Request waiting on the current batch
+struct Query
+{
+    isize client;
+    ServedMesh* mesh; // Mesh to solve on or null if the response is already known
+    isize sources_start; // Range of the query's sources in the batch
+    isize sources_end;
+    Response response;
+};
+
+struct Client
+{
+    int socket{-1}; // Non-blocking
+    DynamicArray<u8> received{};
+    DynamicArray<u8> to_send{};
+    bool is_closed{};
+};
+
+/// Threads kept for the lifetime of the server which run the solves of each batch along with the
+/// main thread
+struct WorkerPool
+{
+    DynamicArray<std::thread> threads{};
+    std::mutex mutex{};
+    std::condition_variable cond{};
+
+    // Current task
+    void (*task)(void const* context, isize thread){};
+    void const* context{};
+    u64 generation{}; // Incremented for each task
+    isize num_running{};
+    bool is_stopping{};
+
+    /// Starts the given total number of threads including the calling thread
+    void start(isize const num_threads)
+    {
+        for (isize i = 1; i < num_threads; ++i)
+            threads.emplace_back(&WorkerPool::work, this, i);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard const lock{mutex};
+            is_stopping = true;
+        }
+        cond.notify_all();
+
+        for (auto& t : threads)
+            t.join();
+
+        threads.clear();
+    }
+
+    isize num_threads() const { return size(threads) + 1; }
+
+    /// Calls func(thread) on each thread with the calling thread as 0. Returns once all calls
+    /// have returned.
+    template <typename Func>
+    void run(Func const& func)
+    {
+        {
+            std::lock_guard const lock{mutex};
+            task = [](void const* const context, isize const thread) {
+                (*static_cast<Func const*>(context))(thread);
+            };
+            context = &func;
+            num_running = size(threads);
+            ++generation;
+        }
+        cond.notify_all();
+
+        func(0);
+
+        std::unique_lock lock{mutex};
+        cond.wait(lock, [&]() { return num_running == 0; });
+    }
+
+  private:
+    void work(isize const thread)
+    {
+        u64 last_generation{0};
+        std::unique_lock lock{mutex};
+
+        while (true)
+        {
+            cond.wait(lock, [&]() { return is_stopping || generation != last_generation; });
+            if (is_stopping)
+                return;
+
+            last_generation = generation;
+            auto const run_task = task;
+            void const* const run_context = context;
+
+            lock.unlock();
+            run_task(run_context, thread);
+            lock.lock();
+
+            if (--num_running == 0)
+                cond.notify_all();
+        }
+    }
+};
+
+struct Server
+{
+    Config config{};
+    int socket{-1};
+    DynamicArray<Client> clients{};
+    DynamicArray<std::unique_ptr<ServedMesh>> meshes{};
+    WorkerPool workers{};
+
+    // Current batch
+    DynamicArray<Query> queries{};
+    DynamicArray<i32> sources{};
+
+    DynamicArray<pollfd> poll_fds{};
+};
+
+bool parse_args(int const argc, char* argv[], Config& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* const arg = argv[i];
+        bool const has_value = (i + 1 < argc);
+
+        if (std::strcmp(arg, "-t") == 0 && has_value)
+            config.time_scale = std::atof(argv[++i]);
+        else if (std::strcmp(arg, "--time") == 0 && has_value)
+            config.time = std::atof(argv[++i]);
+        else if (std::strcmp(arg, "-j") == 0 && has_value)
+            config.num_threads = std::atoi(argv[++i]);
+        else if (arg[0] == '-' || config.socket_path != nullptr)
+            return false;
+        else
+            config.socket_path = arg;
+    }
+
+    if (config.num_threads == 0)
+        config.num_threads = max<isize>(std::thread::hardware_concurrency(), 1);
+
+    return config.socket_path != nullptr && config.time_scale > 0.0f && config.time >= 0.0f
+        && config.num_threads > 0;
+}
+
+std::unique_ptr<ServedMesh> load_mesh(
+    String const& path,
+    isize const num_slots,
+    isize const mesh_index,
+    Config const& config)
+{
+    auto result = std::make_unique<ServedMesh>();
+    auto& m = *result;
+    m.path = path;
+
+    if (!read_mesh_ply(path.c_str(), m.mesh))
+        return nullptr;
+
+    reorder_mesh(m.mesh);
+    isize const num_verts = m.num_vertices();
+
+    m.vert_index.resize(num_verts);
+    for (isize i = 0; i < num_verts; ++i)
+        m.vert_index[m.mesh.vertices.source_ids[i]] = static_cast<i32>(i);
+
+    auto const vert_coords = as_span(m.mesh.vertices.positions).as_const();
+    auto const face_verts = as_span(m.mesh.faces.vertex_ids).as_const();
+
+    m.time = initial_time(vert_coords, face_verts, config.time_scale, config.time);
+    if (!init_with_retry(m.solver, vert_coords, face_verts, m.time, m.num_retries))
+        return nullptr;
+
+    m.workers.resize(config.num_threads);
+    for (auto& w : m.workers)
+        w.distance.resize(num_verts);
+
+    // Allocate result slots in shared memory
+    std::snprintf(m.shm_name, sizeof(m.shm_name), "/geodesic-heat-%d-%td", getpid(), mesh_index);
+    m.num_slots = num_slots;
+
+    int const fd = shm_open(m.shm_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return nullptr;
+
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, m.shm_size()) == 0)
+        data = mmap(nullptr, m.shm_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        shm_unlink(m.shm_name);
+        return nullptr;
+    }
+
+    m.results = static_cast<f32*>(data);
+    return result;
+}
+
+/// Handles a load request. Loads happen as they're received rather than with the rest of the batch
+/// since they're rare and later requests may depend on them.
+Response handle_load(Server& server, String const& path, u32 const num_slots)
+{
+    Response resp{};
+
+    auto const it = std::find_if(
+        server.meshes.begin(),
+        server.meshes.end(),
+        [&](auto const& m) { return m->path == path; });
+
+    isize const mesh_index = it - server.meshes.begin();
+
+    if (it == server.meshes.end())
+    {
+        if (num_slots == 0 || num_slots > max_num_slots)
+        {
+            resp.status = Status_BadRequest;
+            return resp;
+        }
+
+        auto mesh = load_mesh(path, num_slots, mesh_index, server.config);
+        if (mesh == nullptr)
+        {
+            std::fprintf(stderr, "Failed to load mesh \"%s\"\n", path.c_str());
+            resp.status = Status_LoadFailed;
+            return resp;
+        }
+
+        std::fprintf(
+            stderr,
+            "Loaded mesh \"%s\" (%td vertices, %td slots)\n",
+            path.c_str(),
+            mesh->num_vertices(),
+            mesh->num_slots);
+
+        server.meshes.push_back(std::move(mesh));
+    }
+
+    ServedMesh const& m = *server.meshes[mesh_index];
+    resp.status = Status_Ok;
+    resp.mesh = static_cast<u32>(mesh_index);
+    resp.slot = static_cast<u32>(m.num_slots);
+    resp.num_vertices = static_cast<u32>(m.num_vertices());
+    std::memcpy(resp.shm_name, m.shm_name, sizeof(resp.shm_name));
+    return resp;
+}
+
+/// Adds a solve request to the current batch. Its sources are expected at the end of the batch's
+/// sources starting from the given index.
+void handle_solve(
+    Server& server,
+    isize const client,
+    RequestHeader const& header,
+    isize const sources_start)
+{
+    Query query{};
+    query.client = client;
+    query.response.mesh = header.mesh;
+    query.response.slot = header.slot;
+
+    auto const reject = [&]() {
+        query.response.status = Status_BadRequest;
+        server.queries.push_back(query);
+        server.sources.resize(sources_start);
+    };
+
+    if (header.mesh >= server.meshes.size())
+    {
+        reject();
+        return;
+    }
+
+    ServedMesh& m = *server.meshes[header.mesh];
+    query.response.num_vertices = static_cast<u32>(m.num_vertices());
+    std::memcpy(query.response.shm_name, m.shm_name, sizeof(query.response.shm_name));
+
+    auto const sources = as_span(server.sources).segment(
+        sources_start,
+        size(server.sources) - sources_start);
+
+    bool const is_valid =
+        header.slot < m.num_slots && sources.size() > 0
+        && std::all_of(sources.begin(), sources.end(), [&](i32 const v) {
+               return v >= 0 && v < m.num_vertices();
+           });
+
+    if (!is_valid)
+    {
+        reject();
+        return;
+    }
+
+    // Solver can be left uninitialized by a failed retry (see run_batch)
+    if (!m.solver.is_init())
+    {
+        query.response.status = Status_SolveFailed;
+        server.queries.push_back(query);
+        server.sources.resize(sources_start);
+        return;
+    }
+
+    query.mesh = &m;
+    query.sources_start = sources_start;
+    query.sources_end = size(server.sources);
+    server.queries.push_back(query);
+}
+
+/// Handles all complete requests received from the given client. Returns false if the client sent
+/// something that can't be parsed.
+bool handle_requests(Server& server, isize const client_index)
+{
+    auto& received = server.clients[client_index].received;
+    usize offset = 0;
+
+    while (received.size() - offset >= sizeof(RequestHeader))
+    {
+        RequestHeader header;
+        std::memcpy(&header, received.data() + offset, sizeof(header));
+
+        usize payload_size = 0;
+        switch (header.type)
+        {
+            case RequestType_Load:
+            {
+                if (header.count > max_path_size)
+                    return false;
+
+                payload_size = header.count;
+                break;
+            }
+            case RequestType_Solve:
+            {
+                if (header.count > max_num_sources)
+                    return false;
+
+                payload_size = header.count * sizeof(i32);
+                break;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+
+        if (received.size() - offset < sizeof(header) + payload_size)
+            break;
+
+        u8 const* const payload = received.data() + offset + sizeof(header);
+
+        if (header.type == RequestType_Load)
+        {
+            String const path{reinterpret_cast<char const*>(payload), payload_size};
+
+            Query query{};
+            query.client = client_index;
+            query.response = handle_load(server, path, header.slot);
+            server.queries.push_back(query);
+        }
+        else
+        {
+            // NOTE(dr): Payload isn't necessarily aligned for i32 so it's copied rather than viewed
+            auto& sources = server.sources;
+            isize const start = size(sources);
+            sources.resize(start + header.count);
+            std::memcpy(sources.data() + start, payload, payload_size);
+
+            handle_solve(server, client_index, header, start);
+        }
+
+        offset += sizeof(header) + payload_size;
+    }
+
+    received.erase(received.begin(), received.begin() + offset);
+    return true;
+}
+
+void solve_query(Query& query, Span<i32 const> const& sources, ServedMesh::Worker& worker)
+{
+    ServedMesh& m = *query.mesh;
+
+    worker.sources.clear();
+    for (auto const v : sources)
+        worker.sources.push_back(m.vert_index[v]);
+
+    m.solver.solve(
+        as_span(worker.sources).as_const(),
+        as_span(worker.distance),
+        worker.workspace,
+        BoundaryCondition_Averaged);
+
+    if (!worker.workspace.is_solved() || !as_vec(as_span(worker.distance)).allFinite())
+    {
+        query.response.status = Status_SolveFailed;
+        return;
+    }
+
+    // Write to shared memory in file order
+    auto const& source_ids = m.mesh.vertices.source_ids;
+    auto const result = m.slot(query.response.slot);
+
+    for (isize i = 0; i < result.size(); ++i)
+        result[source_ids[i]] = worker.distance[i];
+
+    query.response.status = Status_Ok;
+}
+
+/// Runs all solves in the current batch and queues their responses
+void run_batch(Server& server)
+{
+    DynamicArray<Query*> solves{};
+    for (auto& q : server.queries)
+    {
+        if (q.mesh)
+            solves.push_back(&q);
+    }
+
+    auto const query_sources = [&](Query const& q) {
+        return as_span(server.sources)
+            .segment(q.sources_start, q.sources_end - q.sources_start)
+            .as_const();
+    };
+
+    auto const solve_range = [&](isize const thread, isize const num_threads) {
+        for (isize i = thread; i < size(solves); i += num_threads)
+        {
+            Query& q = *solves[i];
+            solve_query(q, query_sources(q), q.mesh->workers[thread]);
+        }
+    };
+
+    // NOTE(dr): HeatMethod isn't modified by queries so solves on the same mesh can run in
+    // parallel as long as each thread has its own workspace
+    isize const num_threads = server.workers.num_threads();
+    if (num_threads > 1 && size(solves) > 1)
+        server.workers.run([&](isize const thread) { solve_range(thread, num_threads); });
+    else
+        solve_range(0, 1);
+
+    // NOTE(dr): Failed solves are retried with a longer time (as in SolveDistance) once no other
+    // threads are using the solver. The longer time is kept for later queries on the same mesh.
+    for (auto const q : solves)
+    {
+        ServedMesh& m = *q->mesh;
+
+        auto const& status = q->response.status;
+        while (status == Status_SolveFailed && grow_time(m.solver, m.time, m.num_retries))
+            solve_query(*q, query_sources(*q), m.workers[0]);
+
+        if (status == Status_SolveFailed)
+            std::fprintf(stderr, "Failed to solve for distance on \"%s\"\n", m.path.c_str());
+    }
+
+    for (auto const& q : server.queries)
+    {
+        auto& to_send = server.clients[q.client].to_send;
+        auto const bytes = reinterpret_cast<u8 const*>(&q.response);
+        to_send.insert(to_send.end(), bytes, bytes + sizeof(Response));
+    }
+
+    server.queries.clear();
+    server.sources.clear();
+}
+
+bool receive(Client& client)
+{
+    u8 buffer[1 << 16];
+
+    while (true)
+    {
+        ssize_t const n = recv(client.socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+        if (n > 0)
+            client.received.insert(client.received.end(), buffer, buffer + n);
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+/// Sends as much of the pending data as the socket accepts without blocking. The rest is kept for
+/// once the socket is writable again. Returns false if the connection failed.
+bool send_pending(Client& client)
+{
+    auto& to_send = client.to_send;
+    usize offset = 0;
+
+    while (offset < to_send.size())
+    {
+        ssize_t const n = send(
+            client.socket,
+            to_send.data() + offset,
+            to_send.size() - offset,
+            MSG_NOSIGNAL);
+
+        if (n > 0)
+            offset += n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else
+            return false;
+    }
+
+    to_send.erase(to_send.begin(), to_send.begin() + offset);
+    return true;
+}
+
+bool open_socket(Server& server)
+{
+    char const* const path = server.config.socket_path;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+
+    if (std::strlen(path) >= sizeof(addr.sun_path))
+        return false;
+
+    std::strcpy(addr.sun_path, path);
+
+    // Replace a socket left behind by a previous run
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    server.socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server.socket < 0)
+        return false;
+
+    return bind(server.socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0
+        && listen(server.socket, SOMAXCONN) == 0;
+}
+
+void close_sockets(Server& server)
+{
+    for (auto& c : server.clients)
+        close(c.socket);
+
+    server.clients.clear();
+
+    if (server.socket >= 0)
+    {
+        close(server.socket);
+        unlink(server.config.socket_path);
+        server.socket = -1;
+    }
+}
+
+void handle_signal(int) { stop_requested = 1; }
+
+int run(Server& server)
+{
+    if (!open_socket(server))
+    {
+        std::fprintf(stderr, "Failed to open socket \"%s\"\n", server.config.socket_path);
+        close_sockets(server);
+        return EXIT_FAILURE;
+    }
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    server.workers.start(server.config.num_threads);
+
+    std::fprintf(
+        stderr,
+        "Listening on \"%s\" with %td threads\n",
+        server.config.socket_path,
+        server.config.num_threads);
+
+    auto& clients = server.clients;
+    auto& poll_fds = server.poll_fds;
+
+    while (!stop_requested)
+    {
+        poll_fds.clear();
+        poll_fds.push_back({server.socket, POLLIN, 0});
+
+        for (auto const& c : clients)
+        {
+            short events = 0;
+
+            if (c.to_send.size() < max_pending_send)
+                events |= POLLIN;
+
+            if (!c.to_send.empty())
+                events |= POLLOUT;
+
+            poll_fds.push_back({c.socket, events, 0});
+        }
+
+        if (poll(poll_fds.data(), poll_fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            std::fprintf(stderr, "Failed to poll sockets (%s)\n", std::strerror(errno));
+            break;
+        }
+
+        // Read everything that's arrived before running the batch
+        for (isize i = 0; i < size(clients); ++i)
+        {
+            short const revents = poll_fds[i + 1].revents;
+            if ((revents & ~POLLOUT) == 0)
+                continue;
+
+            Client& c = clients[i];
+            c.is_closed = !receive(c) || !handle_requests(server, i);
+        }
+
+        run_batch(server);
+
+        // NOTE(dr): Sends never block so one client not reading its responses doesn't hold up the
+        // others. Whatever doesn't fit in the socket's buffer is sent once it's writable again.
+        for (auto& c : clients)
+        {
+            if (!c.is_closed && !c.to_send.empty())
+                c.is_closed = !send_pending(c);
+        }
+
+        // Remove closed clients
+        {
+            auto const it = std::remove_if(clients.begin(), clients.end(), [](Client const& c) {
+                if (c.is_closed)
+                    close(c.socket);
+
+                return c.is_closed;
+            });
+
+            clients.erase(it, clients.end());
+        }
+
+        if (poll_fds[0].revents & POLLIN)
+        {
+            int const fd = accept(server.socket, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0)
+                {
+                    Client& c = clients.emplace_back();
+                    c.socket = fd;
+                }
+                else
+                {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    server.workers.stop();
+    close_sockets(server);
+    server.meshes.clear();
+
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+} // namespace dr
+
+int main(int argc, char* argv[])
+{
+    using namespace dr;
+
+    Server server{};
+    if (!parse_args(argc, argv, server.config))
+    {
+        std::fprintf(
+            stderr,
+            "Usage: %s <socket path> [-t <time scale>] [--time <time>] [-j <threads>]\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return run(server);
+}
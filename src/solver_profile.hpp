@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+    Compile-time hook for instrumenting the solver headers. Scopes compile to nothing by default so
+    the solvers can be used without the app's profiler. Targets which define GEODESIC_HEAT_PROFILE
+    record them via ProfileScope instead and must link profile.cpp.
+*/
+
+#if GEODESIC_HEAT_PROFILE
+
+#include "profile.hpp"
+
+#define GEODESIC_HEAT_PROFILE_SCOPE(zone) ::dr::ProfileScope const profile_scope_{zone}
+
+#else
+
+#define GEODESIC_HEAT_PROFILE_SCOPE(zone)
+
+#endif
@@ -0,0 +1,437 @@
+#pragma once
+
+/*
+    Smoothed aggregation algebraic multigrid used to precondition conjugate gradients. Has the same
+    interface as SparseLDLT so it can stand in for it in HeatMethod. Memory use and solve time grow
+    roughly linearly with the size of the system (i.e. no factorization fill-in) which makes it the
+    better choice for very large meshes.
+
+    Refs
+    Vaněk, Mandel & Brezina. Algebraic multigrid by smoothed aggregation for second and fourth
+    order elliptic problems. Computing 56 (1996).
+*/
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg_types.hpp>
+
+#include "conjugate_gradient.hpp"
+#include "memory_stats.hpp"
+#include "sparse_ldlt.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct SparseAMG
+{
+    using Matrix = SparseMat<Real, Index>;
+
+    /// Solutions are only accurate to within some tolerance rather than to working precision
+    static constexpr bool is_iterative{true};
+
+    /// Relative residual at which solves are considered converged
+    Real tolerance{1.0e-8};
+
+    /// Relative residual at which solves of singular systems are considered converged. Roundoff in
+    /// the null space limits the residual attainable in single precision so this is larger.
+    Real singular_tolerance{1.0e-5};
+
+    /// Maximum number of iterations per solve
+    isize max_iterations{200};
+
+    /// If true, solves start from the given value of x (e.g. the solution of a previous, similar
+    /// query) rather than zero
+    bool warm_start{true};
+
+    /// Discards the hierarchy built for any previous matrix. Aggregates depend on the relative
+    /// magnitudes of coefficients as well as the sparsity pattern so they're built by the next
+    /// factorization rather than from the (possibly placeholder) values given here. Singular
+    /// systems must have a constant null space (e.g. the Laplacian of a connected mesh).
+    void analyze(Matrix const& /*mat*/, bool const is_singular = false)
+    {
+        is_singular_ = is_singular;
+        is_aggregated_ = false;
+        levels_.clear();
+    }
+
+    /// Builds the operator at each level of the hierarchy from the given matrix which must have
+    /// the same sparsity pattern and singularity as the one last analyzed. Aggregates are built
+    /// by the first successful factorization after analyze and reused by subsequent ones. The
+    /// matrix may be either positive or negative (semi)definite.
+    bool factorize(Matrix const& mat)
+    {
+        if (!build(mat, !is_aggregated_))
+            return false;
+
+        is_aggregated_ = true;
+        return true;
+    }
+
+    /// Solves A x = b. b and x must refer to separate storage.
+    void solve(Span<Real const> const& b, Span<Real> const& x, Span<Real> const& work) const
+    {
+        assert(size() == b.size() && size() == x.size() && work.size() >= work_size());
+        isize const n = size();
+
+        // NOTE(dr): Without any coarse levels, the coarse solver is exact
+        if (levels_.empty())
+        {
+            coarse_solver_.solve(b, x, work.front(n));
+            return;
+        }
+
+        auto rhs = work.front(n);
+        as_vec(rhs) = sign_ * as_vec(b);
+
+        // NOTE(dr): The null space of a singular system is assumed to be constant (e.g. the
+        // Laplacian of a connected mesh) so b is made consistent by removing its mean
+        if (is_singular_)
+            as_vec(rhs).array() -= as_vec(rhs).mean();
+
+        // NOTE(dr): Non-finite values propagate to the solution as they would with a direct solve
+        // rather than running iterations to the limit
+        if (!as_vec(rhs).allFinite())
+        {
+            as_vec(x).setConstant(std::numeric_limits<Real>::quiet_NaN());
+            return;
+        }
+
+        if (!warm_start || !as_vec(x).allFinite())
+            as_vec(x).setZero();
+
+        auto const apply = [&](Span<Real const> const& src, Span<Real> const& dst) {
+            as_vec(dst).noalias() = levels_[0].A * as_vec(src);
+        };
+
+        auto const precond = [&](Span<Real const> const& src, Span<Real> const& dst) {
+            cycle(0, src, dst, work.back(work.size() - 5 * n));
+
+            // NOTE(dr): Keeps search directions orthogonal to the null space which the shifted
+            // coarse solve would otherwise amplify
+            if (is_singular_)
+                as_vec(dst).array() -= as_vec(dst).mean();
+        };
+
+        solve_conjugate_gradient(
+            apply,
+            precond,
+            rhs.as_const(),
+            x,
+            work.segment(n, n),
+            work.segment(2 * n, n),
+            work.segment(3 * n, n),
+            work.segment(4 * n, n),
+            (is_singular_) ? singular_tolerance : tolerance,
+            max_iterations);
+    }
+
+    isize size() const { return (levels_.empty()) ? coarse_solver_.size() : levels_[0].A.rows(); }
+
+    /// Number of elements of scratch storage needed by solves
+    isize work_size() const
+    {
+        if (levels_.empty())
+            return size();
+
+        // Conjugate gradient vectors followed by the residual at each level and the right-hand
+        // side and solution at each coarser level
+        isize result = 5 * size();
+        for (auto const& lv : levels_)
+            result += lv.A.rows() + 2 * lv.P.cols();
+
+        return result + coarse_solver_.work_size();
+    }
+
+    /// Number of levels in the hierarchy including the coarsest
+    isize num_levels() const { return dr::size(levels_) + 1; }
+
+    /// Number of nonzeros in the operator and prolongator of each level along with the strictly
+    /// lower part of the coarse factor
+    isize nnz() const
+    {
+        isize result = coarse_solver_.nnz();
+        for (auto const& lv : levels_)
+            result += lv.A.nonZeros() + lv.P.nonZeros();
+
+        return result;
+    }
+
+    /// Returns the number of bytes used by the hierarchy
+    usize memory_bytes() const
+    {
+        usize result = coarse_solver_.memory_bytes();
+        for (auto const& lv : levels_)
+        {
+            result += dr::memory_bytes(lv.A) + dr::memory_bytes(lv.P)
+                + dr::memory_bytes(lv.inv_diag) + dr::memory_bytes(lv.aggregates);
+        }
+
+        return result;
+    }
+
+  private:
+    struct Level
+    {
+        Matrix A{}; // Operator at this level, scaled to be positive (semi)definite
+        Matrix P{}; // Prolongation from the next coarser level
+        DynamicArray<Real> inv_diag{};
+        DynamicArray<Index> aggregates{}; // Node on the next coarser level of each node
+        isize num_aggregates{};
+    };
+
+    // NOTE(dr): Levels are added until the system is small enough to factorize cheaply or stops
+    // coarsening effectively
+    static constexpr isize max_coarse_size{1000};
+    static constexpr isize max_levels{16};
+    static constexpr Real max_coarsening_ratio{0.8};
+
+    DynamicArray<Level> levels_{};
+    SparseLDLT<Real, Index> coarse_solver_{};
+    Real sign_{1.0};
+    bool is_singular_{};
+    bool is_aggregated_{};
+
+    bool build(Matrix const& mat, bool const aggregate)
+    {
+        assert(mat.rows() == mat.cols());
+
+        // NOTE(dr): Negative semidefinite systems (e.g. the cotan Laplacian) are negated such that
+        // the preconditioner is positive definite
+        sign_ = (mat.diagonal().sum() < Real{0.0}) ? Real{-1.0} : Real{1.0};
+
+        if (aggregate)
+            levels_.clear();
+
+        Matrix A = sign_ * mat;
+
+        for (isize l = 0;; ++l)
+        {
+            if (aggregate)
+            {
+                if (A.rows() <= max_coarse_size || l + 1 == max_levels)
+                    break;
+
+                Level lv{};
+                aggregate_nodes(A, l, lv);
+
+                if (lv.num_aggregates > A.rows() * max_coarsening_ratio)
+                    break;
+
+                levels_.push_back(std::move(lv));
+            }
+            else if (l == dr::size(levels_))
+            {
+                break;
+            }
+
+            Level& lv = levels_[l];
+            lv.A = std::move(A);
+
+            lv.inv_diag.resize(lv.A.rows());
+            as_vec(as_span(lv.inv_diag)) = lv.A.diagonal().cwiseInverse();
+
+            if (!as_vec(as_span(lv.inv_diag)).allFinite())
+                return false;
+
+            smooth_prolongator(lv);
+            A = lv.P.transpose() * lv.A * lv.P;
+        }
+
+        // NOTE(dr): The coarsest operator of a singular system is also singular so it's shifted
+        // slightly to keep the preconditioner definite
+        if (is_singular_ && !levels_.empty())
+            A.diagonal() *= Real{1.0} + Real{1.0e-4};
+
+        // NOTE(dr): Prolongators are pruned of exact zeros so the pattern of the coarsest operator
+        // can change between factorizations. It's small enough to reanalyze each time.
+        coarse_solver_.analyze(A);
+
+        // NOTE(dr): The original sign is restored if there are no coarse levels so that the coarse
+        // solver can be used on its own
+        if (levels_.empty())
+            A *= sign_;
+
+        return coarse_solver_.factorize(A);
+    }
+
+    /// Groups each node with its strongly connected neighbors as in the reference
+    static void aggregate_nodes(Matrix const& A, isize const level, Level& result)
+    {
+        isize const n = A.rows();
+        Real const threshold = Real{0.08} * std::pow(Real{0.5}, Real(level));
+
+        // Connection between i and j is strong if |a_ij| > threshold * sqrt(a_ii a_jj)
+        auto const diag = A.diagonal().eval();
+        auto const is_strong = [&](Index const i, Index const j, Real const a_ij) -> bool {
+            return i != j && std::abs(a_ij) > threshold * std::sqrt(std::abs(diag[i] * diag[j]));
+        };
+
+        auto& agg = result.aggregates;
+        agg.assign(n, Index{-1});
+        Index num_aggs = 0;
+
+        // Form an aggregate from each node whose strong neighbors are all unaggregated
+        for (Index i = 0; i < n; ++i)
+        {
+            if (agg[i] >= 0)
+                continue;
+
+            bool is_free = true;
+            bool has_strong = false;
+            for (typename Matrix::InnerIterator it{A, i}; it && is_free; ++it)
+            {
+                if (is_strong(i, it.row(), it.value()))
+                {
+                    is_free = agg[it.row()] < 0;
+                    has_strong = true;
+                }
+            }
+
+            if (!is_free || !has_strong)
+                continue;
+
+            agg[i] = num_aggs;
+            for (typename Matrix::InnerIterator it{A, i}; it; ++it)
+            {
+                if (is_strong(i, it.row(), it.value()))
+                    agg[it.row()] = num_aggs;
+            }
+
+            ++num_aggs;
+        }
+
+        // Add remaining nodes to the aggregate of their strongest neighbor
+        DynamicArray<Index> prev_agg = agg;
+        for (Index i = 0; i < n; ++i)
+        {
+            if (agg[i] >= 0)
+                continue;
+
+            Real max_strength{0.0};
+            for (typename Matrix::InnerIterator it{A, i}; it; ++it)
+            {
+                Index const j = it.row();
+                Real const strength = std::abs(it.value());
+
+                if (prev_agg[j] >= 0 && is_strong(i, j, it.value()) && strength > max_strength)
+                {
+                    agg[i] = prev_agg[j];
+                    max_strength = strength;
+                }
+            }
+        }
+
+        // Any nodes left over (i.e. those without strong connections) get their own aggregate
+        for (Index i = 0; i < n; ++i)
+        {
+            if (agg[i] < 0)
+                agg[i] = num_aggs++;
+        }
+
+        result.num_aggregates = num_aggs;
+    }
+
+    /// Smooths the piecewise constant prolongator defined by the level's aggregates with a step
+    /// of damped Jacobi
+    static void smooth_prolongator(Level& lv)
+    {
+        isize const n = lv.A.rows();
+        Matrix const& A = lv.A;
+
+        DynamicArray<Triplet<Real, Index>> coeffs{};
+        coeffs.reserve(n);
+        for (Index i = 0; i < n; ++i)
+            coeffs.emplace_back(i, lv.aggregates[i], Real{1.0});
+
+        Matrix P0(n, lv.num_aggregates);
+        P0.setFromTriplets(coeffs.begin(), coeffs.end());
+
+        // NOTE(dr): Bounds the spectral radius of D^-1 A by its max absolute row sum
+        Real rho{0.0};
+        {
+            DynamicArray<Real> row_norms(n, Real{0.0});
+            for (Index j = 0; j < A.outerSize(); ++j)
+            {
+                for (typename Matrix::InnerIterator it{A, j}; it; ++it)
+                    row_norms[it.row()] += std::abs(it.value()) * lv.inv_diag[it.row()];
+            }
+
+            for (auto const r : row_norms)
+                rho = max(rho, r);
+        }
+
+        Real const omega = Real{4.0 / 3.0} / rho;
+        Matrix const inv_D_A = as_vec(as_span(lv.inv_diag)).asDiagonal() * A;
+        lv.P = P0 - omega * (inv_D_A * P0);
+        lv.P.prune(Real{0.0});
+    }
+
+    /// Applies one V-cycle starting from x = 0 with symmetric Gauss-Seidel smoothing
+    void cycle(
+        isize const l,
+        Span<Real const> const& b,
+        Span<Real> const& x,
+        Span<Real> const& work) const
+    {
+        if (l == dr::size(levels_))
+        {
+            coarse_solver_.solve(b, x, work);
+            return;
+        }
+
+        Level const& lv = levels_[l];
+        isize const n = lv.A.rows();
+        isize const n_c = lv.P.cols();
+
+        auto r = work.front(n);
+        auto b_c = work.segment(n, n_c);
+        auto x_c = work.segment(n + n_c, n_c);
+
+        as_vec(x).setZero();
+        smooth(lv, b, x, false);
+
+        // Restrict residual to the coarser level and correct
+        as_vec(r) = as_vec(b);
+        as_vec(r).noalias() -= lv.A * as_vec(x);
+        as_vec(b_c).noalias() = lv.P.transpose() * as_vec(r);
+        cycle(l + 1, b_c.as_const(), x_c, work.back(work.size() - (n + 2 * n_c)));
+        as_vec(x).noalias() += lv.P * as_vec(x_c);
+
+        smooth(lv, b, x, true);
+    }
+
+    /// Applies one sweep of Gauss-Seidel in forward or reverse order. A is symmetric so each row
+    /// is read from the corresponding column.
+    static void smooth(
+        Level const& lv,
+        Span<Real const> const& b,
+        Span<Real> const& x,
+        bool const reverse)
+    {
+        Matrix const& A = lv.A;
+        isize const n = A.rows();
+
+        for (isize k = 0; k < n; ++k)
+        {
+            Index const i = static_cast<Index>((reverse) ? n - 1 - k : k);
+
+            Real sum = b[i];
+            for (typename Matrix::InnerIterator it{A, i}; it; ++it)
+            {
+                if (it.row() != i)
+                    sum -= it.value() * x[it.row()];
+            }
+
+            x[i] = sum * lv.inv_diag[i];
+        }
+    }
+};
+
+} // namespace dr
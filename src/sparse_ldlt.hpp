@@ -0,0 +1,147 @@
+#pragma once
+
+/*
+    Sparse LDLT factorization with solves that write to caller-provided storage (i.e. no heap
+    allocation after factorization) and skip work for right-hand sides with few nonzeros
+*/
+
+#include <cassert>
+
+#include <Eigen/SparseCholesky>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg_types.hpp>
+
+#include "memory_stats.hpp"
+
+namespace dr
+{
+
+template <typename Real, typename Index>
+struct SparseLDLT
+{
+    using Matrix = SparseMat<Real, Index>;
+    using Decomp = Eigen::SimplicialLDLT<Matrix>;
+
+    /// Solutions are accurate to working precision
+    static constexpr bool is_iterative{false};
+
+    /// LDLT handles singular systems with a constant null space as is so `is_singular` is only
+    /// accepted for interface compatibility with iterative solvers
+    void analyze(Matrix const& mat, bool const /*is_singular*/ = false)
+    {
+        decomp_.analyzePattern(mat);
+    }
+
+    bool factorize(Matrix const& mat)
+    {
+        decomp_.factorize(mat);
+        if (decomp_.info() != Eigen::Success)
+            return false;
+
+        inv_diag_.resize(mat.rows());
+        as_vec(as_span(inv_diag_)) = decomp_.vectorD().cwiseInverse();
+        return true;
+    }
+
+    /// Solves A x = b. b and x may refer to the same storage.
+    void solve(Span<Real const> const& b, Span<Real> const& x, Span<Real> const& work) const
+    {
+        assert(size() == b.size() && size() == x.size() && work.size() >= work_size());
+        auto const y = work.front(size());
+
+        // Permute b and find its first nonzero
+        // NOTE(dr): The solution is dense so every entry of y is written here and read by the
+        // backward pass regardless of how sparse b is
+        isize start = size();
+        for (isize i = 0; i < b.size(); ++i)
+        {
+            isize const j = permute(i);
+            y[j] = b[i];
+
+            if (b[i] != Real{0.0})
+                start = min(start, j);
+        }
+
+        solve_permuted(y, start);
+        unpermute(y, x);
+    }
+
+    isize size() const { return as_span(inv_diag_).size(); }
+
+    /// Number of elements of scratch storage needed by solves
+    isize work_size() const { return size(); }
+
+    /// Number of nonzeros in the strictly lower part of L
+    isize nnz() const { return (size() > 0) ? decomp_.matrixL().nestedExpression().nonZeros() : 0; }
+
+    /// Returns the number of bytes used by the factorization
+    usize memory_bytes() const
+    {
+        if (size() == 0)
+            return 0;
+
+        // NOTE(dr): Also counts D and its cached inverse along with the permutation and its inverse
+        return dr::memory_bytes(decomp_.matrixL().nestedExpression())
+            + size() * (2 * sizeof(Real) + 2 * sizeof(Index));
+    }
+
+    Decomp const& decomp() const { return decomp_; }
+
+  private:
+    Decomp decomp_{};
+    DynamicArray<Real> inv_diag_{};
+
+    isize permute(isize const i) const
+    {
+        auto const& perm = decomp_.permutationP().indices();
+        return (perm.size() > 0) ? perm[i] : i;
+    }
+
+    void unpermute(Span<Real const> const& src, Span<Real> const& dst) const
+    {
+        for (isize i = 0; i < dst.size(); ++i)
+            dst[i] = src[permute(i)];
+    }
+
+    /// Solves L D L^T y = b in place where b has already been permuted. Entries of b before
+    /// `start` must be zero.
+    void solve_permuted(Span<Real> const& y, isize const start) const
+    {
+        Matrix const& mat_L = decomp_.matrixL().nestedExpression();
+        Index const* const col_starts = mat_L.outerIndexPtr();
+        Index const* const rows = mat_L.innerIndexPtr();
+        Real const* const values = mat_L.valuePtr();
+        isize const n = y.size();
+
+        // Forward substitution. L is unit lower triangular and stored by column so zero entries
+        // of the right-hand side (including any leading zeros) don't propagate.
+        for (isize j = start; j < n; ++j)
+        {
+            Real const y_j = y[j];
+            if (y_j == Real{0.0})
+                continue;
+
+            for (Index p = col_starts[j]; p < col_starts[j + 1]; ++p)
+                y[rows[p]] -= values[p] * y_j;
+        }
+
+        // Diagonal
+        as_vec(y).array() *= as_vec(as_span(inv_diag_)).array();
+
+        // Backward substitution with L^T
+        for (isize j = n - 1; j >= 0; --j)
+        {
+            Real y_j = y[j];
+            for (Index p = col_starts[j]; p < col_starts[j + 1]; ++p)
+                y_j -= values[p] * y[rows[p]];
+
+            y[j] = y_j;
+        }
+    }
+};
+
+} // namespace dr
@@ -4,75 +4,184 @@
 
 #include <dr/math.hpp>
 
+#include "diffusion_time.hpp"
+#include "mesh_utils.hpp"
+#include "profile.hpp"
+
 namespace dr
 {
-namespace
+void LoadMeshAsset::operator()()
 {
+    ProfileScope const scope{ProfileZone_LoadMeshAsset};
+    output.mesh = get_asset(input.handle, input.refine_level, input.reorder);
+    assert(output.mesh);
+}
 
-f32 mean_edge_length(
-    Span<Vec3<f32> const> const vertex_positions,
-    Span<Vec3<i32> const> const face_vertices)
+void ApproximateDistance::operator()()
 {
-    f32 length_sum{0.0f};
-    for (auto const& f_v : face_vertices)
+    ProfileScope const scope{ProfileZone_ApproximateDistance};
+    assert(input.mesh);
+
+    // Cache edge lengths of the input mesh
+    if (input.mesh != prev_mesh_)
     {
-        Vec3<f32> const& a = vertex_positions[f_v[0]];
-        Vec3<f32> const& b = vertex_positions[f_v[1]];
-        Vec3<f32> const& c = vertex_positions[f_v[2]];
-        length_sum += (a - b).norm() + (b - c).norm() + (c - a).norm();
-    }
+        auto const positions = as_span(input.mesh->vertices.positions).as_const();
+        isize const num_verts = positions.size();
+
+        DynamicArray<Vec2<i32>> edges{};
+        collect_edges(as_span(input.mesh->faces.vertex_ids).as_const(), edges);
+        collect_vertex_neighbors(
+            as_span(edges).as_const(),
+            num_verts,
+            neighbor_offsets_,
+            neighbors_);
+
+        edge_lengths_.resize(size(neighbors_));
+        for (isize i = 0; i < num_verts; ++i)
+        {
+            for (i32 j = neighbor_offsets_[i]; j < neighbor_offsets_[i + 1]; ++j)
+                edge_lengths_[j] = (positions[neighbors_[j]] - positions[i]).norm();
+        }
 
-    // NOTE(dr): This assumes the mesh has no boundary
-    isize const num_edges = face_vertices.size() * 6;
-    return length_sum / num_edges;
-}
+        distance_.resize(num_verts);
+        prev_mesh_ = input.mesh;
+    }
 
-} // namespace
+    graph_distance(
+        as_span(neighbor_offsets_).as_const(),
+        as_span(neighbors_).as_const(),
+        as_span(edge_lengths_).as_const(),
+        input.source_vertices,
+        as_span(distance_),
+        heap_);
 
-void LoadMeshAsset::operator()()
-{
-    output.mesh = get_asset(input.handle);
-    assert(output.mesh);
+    output.distance = as_span(distance_);
 }
 
 void SolveDistance::operator()()
 {
+    ProfileScope const scope{ProfileZone_SolveDistance};
     assert(input.mesh);
+    assert(input.time_scale > 0.0f);
+
+    // Create the requested solver and release the others
+    if (input.method == Method_Direct && !direct_)
+    {
+        iterative_.reset();
+        multigrid_.reset();
+        direct_ = std::make_unique<decltype(direct_)::element_type>();
+        prev_mesh_ = nullptr;
+    }
+    else if (input.method == Method_Iterative && !iterative_)
+    {
+        direct_.reset();
+        multigrid_.reset();
+        iterative_ = std::make_unique<decltype(iterative_)::element_type>();
+        prev_mesh_ = nullptr;
+    }
+    else if (input.method == Method_Multigrid && !multigrid_)
+    {
+        direct_.reset();
+        iterative_.reset();
+        multigrid_ = std::make_unique<decltype(multigrid_)::element_type>();
+        prev_mesh_ = nullptr;
+    }
+
+    auto const solve_with = [&](auto& state) -> bool {
+        bool const ok = solve(state.solver, state.workspace);
+        output.stats = state.solver.stats();
+        output.workspace_bytes = state.workspace.memory_bytes();
+        return ok;
+    };
+
+    bool ok;
+    switch (input.method)
+    {
+        case Method_Direct:
+        {
+            ok = solve_with(*direct_);
+            break;
+        }
+        case Method_Iterative:
+        {
+            ok = solve_with(*iterative_);
+            break;
+        }
+        default:
+        {
+            ok = solve_with(*multigrid_);
+        }
+    }
+
+    if (!ok)
+    {
+        set_error(Error_SolveFailed);
+        return;
+    }
+
+    output.distance = as_span(distance_);
+    output.time = time_;
+    output.error = {};
+}
+
+template <typename Solver>
+bool SolveDistance::solve(Solver& solver, typename Solver::Workspace& workspace)
+{
+    auto const vert_coords = as_span(input.mesh->vertices.positions).as_const();
+    auto const face_verts = as_span(input.mesh->faces.vertex_ids).as_const();
+
+    i32 num_retries = 0;
+    bool ok = true;
 
     // Reinitialize solver if input mesh changed
     if (input.mesh != prev_mesh_)
     {
-        // NOTE(dr): Paper recommends square mean edge length as a good choice for t
-        f32 const mean_edge_len = mean_edge_length(
-            as_span(input.mesh->vertices.positions),
-            as_span(input.mesh->faces.vertex_ids));
-
-        // NOTE(dr): Solve tends to fail for values less than this
-        constexpr f32 min_time = 0.005f;
-        f32 const time = max(mean_edge_len * mean_edge_len, min_time);
-
-        // Initialize solver
-        bool const ok = solver_.init(
-            as_span(input.mesh->vertices.positions),
-            as_span(input.mesh->faces.vertex_ids),
-            time);
-
-        if (!ok)
+        prev_mesh_ = nullptr;
+        default_time_ = default_time(vert_coords, face_verts);
+        time_ = default_time_ * input.time_scale;
+
+        ok = init_with_retry(solver, vert_coords, face_verts, time_, num_retries);
+        if (ok)
         {
-            output.distance = {};
-            output.error = Error_SolveFailed;
-            return;
+            prev_mesh_ = input.mesh;
+            time_scale_ = input.time_scale;
+            distance_.resize(input.mesh->vertices.count());
         }
+    }
+    else if (input.time_scale != time_scale_ || !solver.is_init())
+    {
+        time_ = default_time_ * input.time_scale;
 
-        prev_mesh_ = input.mesh;
+        ok = solver.reinit(time_) || grow_time(solver, time_, num_retries);
+        if (ok)
+            time_scale_ = input.time_scale;
     }
 
     // Solve distance
-    distance_.resize(input.mesh->vertices.count());
-    solver_.solve(input.source_vertices, as_span(distance_));
+    auto const solve = [&]() -> bool {
+        profile_count(ProfileCounter_Solves);
 
-    output.distance = as_span(distance_);
-    output.error = {};
+        solver.solve(
+            input.source_vertices,
+            as_span(distance_),
+            workspace,
+            input.boundary_condition);
+
+        return workspace.is_solved() && as_vec(as_span(distance_)).allFinite();
+    };
+
+    if (ok)
+        ok = solve_with_retry(solver, time_, num_retries, solve);
+
+    profile_count(ProfileCounter_TimeRetries, num_retries);
+    return ok;
+}
+
+void SolveDistance::set_error(Error const error)
+{
+    output.distance = {};
+    output.time = 0.0f;
+    output.error = error;
 }
 
 } // namespace dr
\ No newline at end of file
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <memory>
+#include <utility>
+
 #include <dr/dynamic_array.hpp>
 #include <dr/span.hpp>
 
 #include "assets.hpp"
 #include "heat_method.hpp"
+#include "heat_method_matrix_free.hpp"
+#include "sparse_amg.hpp"
 
 namespace dr
 {
@@ -14,6 +19,8 @@ struct LoadMeshAsset
     struct
     {
         AssetHandle::Mesh handle;
+        i32 refine_level;
+        bool reorder;
     } input;
 
     struct
@@ -24,6 +31,32 @@ struct LoadMeshAsset
     void operator()();
 };
 
+/// Approximates distance from source vertices by the shortest path along mesh edges. Much cheaper
+/// than SolveDistance and intended for display while it's in flight.
+struct ApproximateDistance
+{
+    struct
+    {
+        MeshAsset const* mesh;
+        Span<const i32> source_vertices;
+    } input;
+
+    struct
+    {
+        Span<f32> distance;
+    } output;
+
+    void operator()();
+
+  private:
+    DynamicArray<i32> neighbor_offsets_;
+    DynamicArray<i32> neighbors_;
+    DynamicArray<f32> edge_lengths_;
+    DynamicArray<std::pair<f32, i32>> heap_;
+    DynamicArray<f32> distance_;
+    MeshAsset const* prev_mesh_;
+};
+
 struct SolveDistance
 {
     enum Error : u8
@@ -33,24 +66,56 @@ struct SolveDistance
         _Error_Count,
     };
 
+    enum Method : u8
+    {
+        Method_Direct = 0, // Sparse factorization, fastest solves
+        Method_Iterative, // Matrix-free conjugate gradients, lowest memory use
+        Method_Multigrid, // Multigrid-preconditioned conjugate gradients, scales to large meshes
+        _Method_Count,
+    };
+
     struct
     {
         MeshAsset const* mesh;
         Span<const i32> source_vertices;
+        f32 time_scale{1.0f}; // Multiple of the squared mean edge length used as t
+        BoundaryCondition boundary_condition{BoundaryCondition_Averaged};
+        Method method{Method_Direct};
     } input;
 
     struct
     {
         Span<f32> distance;
+        f32 time;
         Error error;
+        HeatMethodStats stats;
+        usize workspace_bytes;
     } output;
 
     void operator()();
 
   private:
-    HeatMethod<f32, i32> solver_;
+    template <typename Solver>
+    struct SolverState
+    {
+        Solver solver;
+        typename Solver::Workspace workspace;
+    };
+
+    // NOTE(dr): Only one solver is kept alive at a time
+    std::unique_ptr<SolverState<HeatMethod<f32, i32>>> direct_;
+    std::unique_ptr<SolverState<HeatMethodMatrixFree<f32, i32>>> iterative_;
+    std::unique_ptr<SolverState<HeatMethod<f32, i32, SparseAMG<f32, i32>>>> multigrid_;
     DynamicArray<f32> distance_;
     MeshAsset const* prev_mesh_;
+    f32 default_time_; // Unscaled default time of the previous mesh
+    f32 time_scale_;
+    f32 time_;
+
+    template <typename Solver>
+    bool solve(Solver& solver, typename Solver::Workspace& workspace);
+
+    void set_error(Error error);
 };
 
 } // namespace dr
\ No newline at end of file
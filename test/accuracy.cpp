@@ -0,0 +1,333 @@
+/*
+    Compares each solver configuration against exact geodesic distance on generated spheres and
+    hemispheres of increasing resolution. Fails if the mean relative error of any configuration
+    exceeds the limit.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/math_types.hpp>
+#include <dr/span.hpp>
+#include <dr/string.hpp>
+
+#include "diffusion_time.hpp"
+#include "heat_method.hpp"
+#include "heat_method_matrix_free.hpp"
+#include "mesh_gen.hpp"
+#include "mesh_io.hpp"
+#include "sparse_amg.hpp"
+
+namespace dr
+{
+namespace
+{
+
+/// Largest mean relative error accepted for any configuration
+constexpr f64 max_mean_error = 0.05;
+
+/// Meshes are generated at increasing resolution up to this many faces
+constexpr isize max_faces = 25'000;
+
+/// Creates the part of a subdivided icosphere above the xy plane
+void make_hemisphere(isize const num_subdivisions, MeshAsset& mesh)
+{
+    make_icosphere(num_subdivisions, mesh);
+
+    auto const& positions = mesh.vertices.positions;
+    auto& face_verts = mesh.faces.vertex_ids;
+
+    // Keep faces with all vertices on or above the plane
+    isize num_faces = 0;
+    for (isize i = 0; i < face_verts.cols(); ++i)
+    {
+        Vec3<i32> const f_v = face_verts.col(i);
+        if (positions(2, f_v[0]) >= 0.0f && positions(2, f_v[1]) >= 0.0f
+            && positions(2, f_v[2]) >= 0.0f)
+            face_verts.col(num_faces++) = f_v;
+    }
+    face_verts.conservativeResize(Eigen::NoChange, num_faces);
+
+    // Remove unused vertices
+    DynamicArray<i32> vert_index(mesh.vertices.count(), -1);
+    for (auto const& f_v : as_span(face_verts))
+    {
+        for (int j = 0; j < 3; ++j)
+            vert_index[f_v[j]] = 0;
+    }
+
+    isize num_verts = 0;
+    for (isize i = 0; i < size(vert_index); ++i)
+    {
+        if (vert_index[i] < 0)
+            continue;
+
+        mesh.vertices.positions.col(num_verts) = mesh.vertices.positions.col(i);
+        mesh.vertices.tex_coords.col(num_verts) = mesh.vertices.tex_coords.col(i);
+        vert_index[i] = static_cast<i32>(num_verts++);
+    }
+
+    mesh.vertices.positions.conservativeResize(Eigen::NoChange, num_verts);
+    mesh.vertices.tex_coords.conservativeResize(Eigen::NoChange, num_verts);
+
+    for (auto& f_v : as_span(face_verts))
+    {
+        for (int j = 0; j < 3; ++j)
+            f_v[j] = vert_index[f_v[j]];
+    }
+}
+
+/// Solves for distance from a single source, growing t if heat underflows
+template <typename Solver>
+bool solve_accuracy(
+    Solver& solver,
+    i32 const source,
+    BoundaryCondition const boundary,
+    Span<f32> const& distance,
+    f32& time,
+    i32& num_retries)
+{
+    typename Solver::Workspace workspace{};
+
+    auto const solve = [&]() -> bool {
+        solver.solve(Span<i32 const>{&source, 1}, distance, workspace, boundary);
+        return workspace.is_solved() && as_vec(distance).allFinite();
+    };
+
+    return solver.is_init() && solve_with_retry(solver, time, num_retries, solve);
+}
+
+template <typename Solver>
+bool test_solver(char const* const solver_name, MeshAsset const& mesh, String const& mesh_name)
+{
+    static char const* const bc_names[_BoundaryCondition_Count]{
+        "neumann",
+        "dirichlet",
+        "averaged",
+    };
+
+    auto const vert_coords = as_span(mesh.vertices.positions).as_const();
+    auto const face_verts = as_span(mesh.faces.vertex_ids).as_const();
+    isize const num_verts = vert_coords.size();
+
+    // Source is the vertex closest to the pole
+    i32 source{};
+    for (isize i = 1; i < num_verts; ++i)
+    {
+        if (vert_coords[i].z() > vert_coords[source].z())
+            source = static_cast<i32>(i);
+    }
+
+    // Distance on the unit sphere is the angle between vertices
+    DynamicArray<f64> exact(num_verts);
+    for (isize i = 0; i < num_verts; ++i)
+    {
+        f64 const cos_angle = vert_coords[source].cast<f64>().normalized().dot(
+            vert_coords[i].cast<f64>().normalized());
+        exact[i] = std::acos(clamp(cos_angle, -1.0, 1.0));
+    }
+
+    f32 const init_time = default_time(vert_coords, face_verts);
+
+    Solver solver{};
+    f32 time = init_time;
+    i32 num_retries = 0;
+    bool init_ok = init_with_retry(solver, vert_coords, face_verts, time, num_retries);
+
+    DynamicArray<f32> distance(num_verts);
+    bool ok = true;
+
+    for (u8 i = 0; i < _BoundaryCondition_Count; ++i)
+    {
+        // Each configuration starts from the same time step with its own retries
+        if (time != init_time && solver.is_assembled())
+        {
+            num_retries = 0;
+            init_ok = solver.reinit(time = init_time) || grow_time(solver, time, num_retries);
+        }
+
+        bool const is_solved = init_ok
+            && solve_accuracy(
+                solver,
+                source,
+                BoundaryCondition{i},
+                as_span(distance),
+                time,
+                num_retries);
+
+        f64 mean_error{INFINITY};
+        f64 max_error{INFINITY};
+
+        if (is_solved)
+        {
+            f64 error_sum{0.0};
+            max_error = 0.0;
+
+            for (isize j = 0; j < num_verts; ++j)
+            {
+                if (j == source)
+                    continue;
+
+                f64 const error = std::abs(distance[j] - exact[j]) / exact[j];
+                error_sum += error;
+                max_error = max(max_error, error);
+            }
+
+            mean_error = error_sum / (num_verts - 1);
+        }
+
+        bool const passed = mean_error <= max_mean_error;
+        std::printf(
+            "%s (%td faces), %s, %s: %s (mean error %.4f, max error %.4f)\n",
+            mesh_name.c_str(),
+            mesh.faces.count(),
+            solver_name,
+            bc_names[i],
+            passed ? "passed" : "FAILED",
+            mean_error,
+            max_error);
+
+        ok &= passed;
+    }
+
+    return ok;
+}
+
+/// Same as test_solver but solves with a lagged factorization after the mesh is scaled slightly.
+/// Distances scale with the mesh so the exact solution is known.
+template <typename Solver>
+bool test_lagged(char const* const solver_name, MeshAsset const& mesh, String const& mesh_name)
+{
+    constexpr f32 scale = 1.01f;
+
+    auto const vert_coords = as_span(mesh.vertices.positions).as_const();
+    auto const face_verts = as_span(mesh.faces.vertex_ids).as_const();
+    isize const num_verts = vert_coords.size();
+
+    i32 source{};
+    for (isize i = 1; i < num_verts; ++i)
+    {
+        if (vert_coords[i].z() > vert_coords[source].z())
+            source = static_cast<i32>(i);
+    }
+
+    // Find a time step at which the original mesh solves
+    Solver solver{};
+    f32 time = default_time(vert_coords, face_verts);
+    i32 num_retries = 0;
+    DynamicArray<f32> distance(num_verts);
+
+    bool is_solved = init_with_retry(solver, vert_coords, face_verts, time, num_retries)
+        && solve_accuracy(
+            solver,
+            source,
+            BoundaryCondition_Neumann,
+            as_span(distance),
+            time,
+            num_retries);
+
+    DynamicArray<Vec3<f32>> positions(vert_coords.begin(), vert_coords.end());
+    for (auto& p : positions)
+        p *= scale;
+
+    // NOTE(dr): Solved once without retrying since growing t would refactor the heat operator
+    typename Solver::Workspace workspace{};
+    if (is_solved && solver.update_positions(as_span(positions).as_const(), time, false))
+    {
+        solver.solve(Span<i32 const>{&source, 1}, as_span(distance), workspace);
+        is_solved = workspace.is_solved() && as_vec(as_span(distance)).allFinite();
+    }
+    else
+    {
+        is_solved = false;
+    }
+
+    f64 mean_error{INFINITY};
+
+    if (is_solved)
+    {
+        Vec3<f64> const p_src = vert_coords[source].cast<f64>().normalized();
+        f64 error_sum{0.0};
+
+        for (isize j = 0; j < num_verts; ++j)
+        {
+            if (j == source)
+                continue;
+
+            f64 const cos_angle = p_src.dot(vert_coords[j].cast<f64>().normalized());
+            f64 const exact = scale * std::acos(clamp(cos_angle, -1.0, 1.0));
+            error_sum += std::abs(distance[j] - exact) / exact;
+        }
+
+        mean_error = error_sum / (num_verts - 1);
+    }
+
+    bool const passed = mean_error <= max_mean_error;
+    std::printf(
+        "%s (%td faces), %s, lagged: %s (mean error %.4f)\n",
+        mesh_name.c_str(),
+        mesh.faces.count(),
+        solver_name,
+        passed ? "passed" : "FAILED",
+        mean_error);
+
+    return passed;
+}
+
+} // namespace
+} // namespace dr
+
+int main()
+{
+    using namespace dr;
+    using MakeMesh = void(isize, MeshAsset&);
+
+    static constexpr struct
+    {
+        char const* name;
+        MakeMesh* make;
+    } meshes[]{
+        {"sphere", make_icosphere},
+        {"hemisphere", make_hemisphere},
+    };
+
+    bool ok = true;
+
+    for (auto const& [name, make] : meshes)
+    {
+        for (isize level = 2;; ++level)
+        {
+            MeshAsset mesh{};
+            make(level, mesh);
+
+            if (mesh.faces.count() > max_faces)
+                break;
+
+            reorder_mesh(mesh);
+
+            String mesh_name{name};
+            mesh_name += '-';
+            mesh_name += std::to_string(level).c_str();
+
+            ok &= test_solver<HeatMethod<f32, i32>>("direct", mesh, mesh_name);
+            ok &= test_solver<HeatMethodMatrixFree<f32, i32>>("iterative", mesh, mesh_name);
+            ok &= test_solver<HeatMethod<f32, i32, SparseAMG<f32, i32>>>(
+                "multigrid",
+                mesh,
+                mesh_name);
+
+            ok &= test_lagged<HeatMethod<f32, i32>>("direct", mesh, mesh_name);
+            ok &= test_lagged<HeatMethod<f32, i32, SparseAMG<f32, i32>>>(
+                "multigrid",
+                mesh,
+                mesh_name);
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
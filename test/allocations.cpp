@@ -0,0 +1,225 @@
+/*
+    Checks that repeated queries against an initialized solver don't allocate once the workspace
+    has been warmed up. Allocations made via operator new are counted here. Eigen allocates its
+    temporaries via malloc instead so those are caught by its own runtime check.
+*/
+
+// NOTE(dr): Eigen's runtime check is an assertion so it must stay enabled in release builds
+#undef NDEBUG
+#define EIGEN_RUNTIME_NO_MALLOC
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/span.hpp>
+
+#include "diffusion_time.hpp"
+#include "heat_method.hpp"
+#include "heat_method_matrix_free.hpp"
+#include "mesh_gen.hpp"
+#include "sparse_amg.hpp"
+
+namespace
+{
+
+dr::isize num_allocs{0};
+
+} // namespace
+
+// NOTE(dr): Not inlined so GCC doesn't mistake std::free for a mismatched deallocation
+[[gnu::noinline]] void* operator new(std::size_t const size)
+{
+    ++num_allocs;
+
+    if (void* const ptr = std::malloc(size))
+        return ptr;
+
+    throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void operator delete(void* const ptr) noexcept { std::free(ptr); }
+
+[[gnu::noinline]] void operator delete(void* const ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace dr
+{
+namespace
+{
+
+/// Number of queries made after warm-up
+constexpr isize num_queries = 3;
+
+/// Calls `query` once to warm up then returns the number of allocations made by the following
+/// calls
+template <typename Query>
+isize count_allocs(Query&& query)
+{
+    query();
+
+    isize const start = num_allocs;
+    Eigen::internal::set_is_malloc_allowed(false);
+
+    for (isize i = 0; i < num_queries; ++i)
+        query();
+
+    Eigen::internal::set_is_malloc_allowed(true);
+    return num_allocs - start;
+}
+
+/// Prints the result of a query which passes if it solved without allocating
+bool report(
+    char const* const solver_name,
+    char const* const query_name,
+    isize const allocs,
+    bool const is_solved)
+{
+    bool const passed = allocs == 0 && is_solved;
+    std::printf(
+        "%s, %s: %s (%td allocations, %s)\n",
+        solver_name,
+        query_name,
+        passed ? "passed" : "FAILED",
+        allocs,
+        is_solved ? "solved" : "not solved");
+
+    return passed;
+}
+
+/// Initializes the given solver at a time step for which all queries solve. t is grown until
+/// they do since heat underflows at the default t on meshes of this size.
+template <typename Solver>
+bool init_solver(
+    char const* const solver_name,
+    Solver& solver,
+    MeshAsset const& mesh,
+    Span<i32 const> const& sources,
+    f32& time)
+{
+    auto const vert_coords = as_span(mesh.vertices.positions).as_const();
+    auto const face_verts = as_span(mesh.faces.vertex_ids).as_const();
+
+    DynamicArray<f32> distance(vert_coords.size());
+    typename Solver::Workspace workspace{};
+    i32 num_retries = 0;
+
+    auto const solve = [&]() -> bool {
+        for (u8 i = 0; i < _BoundaryCondition_Count; ++i)
+        {
+            solver.solve(sources, as_span(distance), workspace, BoundaryCondition{i});
+            if (!workspace.is_solved())
+                return false;
+        }
+
+        return true;
+    };
+
+    time = default_time(vert_coords, face_verts);
+    if (init_with_retry(solver, vert_coords, face_verts, time, num_retries)
+        && solve_with_retry(solver, time, num_retries, solve))
+        return true;
+
+    std::fprintf(stderr, "%s: init failed\n", solver_name);
+    return false;
+}
+
+template <typename Solver>
+bool test_solver(char const* const solver_name, MeshAsset const& mesh)
+{
+    static char const* const bc_names[_BoundaryCondition_Count]{
+        "neumann",
+        "dirichlet",
+        "averaged",
+    };
+
+    isize const num_verts = mesh.vertices.count();
+
+    // Interior and boundary sources
+    DynamicArray<i32> const sources{0, i32(num_verts / 2)};
+    DynamicArray<f32> distance(num_verts);
+
+    Solver solver{};
+    f32 time{};
+    if (!init_solver(solver_name, solver, mesh, as_span(sources).as_const(), time))
+        return false;
+
+    typename Solver::Workspace workspace{};
+    bool ok = true;
+
+    for (u8 i = 0; i < _BoundaryCondition_Count; ++i)
+    {
+        isize const allocs = count_allocs([&]() {
+            solver.solve(
+                as_span(sources).as_const(),
+                as_span(distance),
+                workspace,
+                BoundaryCondition{i});
+        });
+
+        ok &= report(solver_name, bc_names[i], allocs, workspace.is_solved());
+    }
+
+    return ok;
+}
+
+/// Same as test_solver but solves with a lagged factorization after positions are updated
+template <typename Solver>
+bool test_lagged(char const* const solver_name, MeshAsset const& mesh)
+{
+    auto const vert_coords = as_span(mesh.vertices.positions).as_const();
+
+    DynamicArray<i32> const sources{0, i32(vert_coords.size() / 2)};
+    DynamicArray<f32> distance(vert_coords.size());
+
+    Solver solver{};
+    f32 time{};
+    if (!init_solver(solver_name, solver, mesh, as_span(sources).as_const(), time))
+        return false;
+
+    // Perturb positions without refactoring
+    DynamicArray<Vec3<f32>> positions(vert_coords.begin(), vert_coords.end());
+    for (auto& p : positions)
+        p *= 1.01f;
+
+    if (!solver.update_positions(as_span(positions).as_const(), time, false))
+    {
+        std::fprintf(stderr, "%s: update failed\n", solver_name);
+        return false;
+    }
+
+    typename Solver::Workspace workspace{};
+
+    isize const allocs = count_allocs([&]() {
+        solver.solve(as_span(sources).as_const(), as_span(distance), workspace);
+    });
+
+    return report(solver_name, "lagged", allocs, workspace.is_solved());
+}
+
+} // namespace
+} // namespace dr
+
+int main()
+{
+    using namespace dr;
+
+    // Torus with a ring of faces removed to give it a boundary
+    constexpr isize num_major = 64;
+    constexpr isize num_minor = 16;
+
+    MeshAsset mesh{};
+    make_torus(num_major, num_minor, 1.0f, 0.25f, mesh);
+    {
+        auto& face_verts = mesh.faces.vertex_ids;
+        isize const num_faces = face_verts.cols() - 2 * num_minor;
+        face_verts = face_verts.rightCols(num_faces).eval();
+    }
+
+    bool ok = test_solver<HeatMethod<f32, i32>>("direct", mesh);
+    ok &= test_lagged<HeatMethod<f32, i32>>("direct", mesh);
+    ok &= test_solver<HeatMethod<f32, i32, SparseAMG<f32, i32>>>("multigrid", mesh);
+    ok &= test_solver<HeatMethodMatrixFree<f32, i32>>("iterative", mesh);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
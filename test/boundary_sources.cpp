@@ -0,0 +1,327 @@
+/*
+    Solves for distance on a flat grid from sources on its boundary with each solver and boundary
+    condition. Distance on a flat grid is Euclidean so results are compared against it.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <Eigen/SparseCholesky>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/linalg_reshape.hpp>
+#include <dr/math.hpp>
+#include <dr/math_types.hpp>
+#include <dr/mesh_attributes.hpp>
+#include <dr/mesh_operators.hpp>
+#include <dr/span.hpp>
+#include <dr/sparse_linalg_types.hpp>
+
+#include "diffusion_time.hpp"
+#include "heat_method.hpp"
+#include "heat_method_matrix_free.hpp"
+#include "sparse_amg.hpp"
+
+namespace dr
+{
+namespace
+{
+
+/// Largest mean relative error accepted for each boundary condition. Errors are larger when t has
+/// to be grown (e.g. for the iterative solver).
+// NOTE(dr): Dirichlet conditions pull isolines parallel to the boundary so distance is much less
+// accurate for sources on it. Temperatures are also checked against a reference solve in this
+// case (see max_temperature_error) since distance alone can't tell a wrong solve from this.
+constexpr f64 max_mean_error[_BoundaryCondition_Count]{0.1, 0.3, 0.1};
+
+/// Largest error in Dirichlet temperatures accepted relative to the peak of the reference
+constexpr f64 max_temperature_error = 1.0e-4;
+
+struct Grid
+{
+    DynamicArray<Vec3<f32>> positions;
+    DynamicArray<Vec3<i32>> faces;
+    DynamicArray<i32> vertex_ids; // Vertex at each pair of axial coordinates
+    i32 radius;
+
+    /// Returns the vertex at the given axial coordinates or -1 if it's outside the grid
+    i32 vertex(i32 const q, i32 const r) const
+    {
+        i32 const n = radius;
+        if (max(abs(q), max(abs(r), abs(q + r))) > n)
+            return -1;
+
+        return vertex_ids[(r + n) * (2 * n + 1) + (q + n)];
+    }
+};
+
+/// Creates a regular hexagon of equilateral triangles with the given number of triangles along
+/// each side and a circumradius of 1
+void make_grid(i32 const radius, Grid& result)
+{
+    // NOTE(dr): Every face of a hexagon has at least one interior vertex. Faces with only
+    // boundary vertices (e.g. at the corners of a square grid) have no temperature gradient with
+    // Dirichlet conditions.
+    i32 const n = radius;
+    f32 const height = std::sqrt(3.0f) * 0.5f;
+
+    result.radius = n;
+    result.positions.clear();
+    result.faces.clear();
+    result.vertex_ids.assign((2 * n + 1) * (2 * n + 1), -1);
+
+    for (i32 r = -n; r <= n; ++r)
+    {
+        for (i32 q = -n; q <= n; ++q)
+        {
+            if (abs(q + r) > n)
+                continue;
+
+            result.vertex_ids[(r + n) * (2 * n + 1) + (q + n)] = size(result.positions);
+            result.positions.emplace_back((q + 0.5f * r) / n, height * r / n, 0.0f);
+        }
+    }
+
+    for (i32 r = -n; r < n; ++r)
+    {
+        for (i32 q = -n; q < n; ++q)
+        {
+            i32 const v0 = result.vertex(q, r);
+            i32 const v1 = result.vertex(q + 1, r);
+            i32 const v2 = result.vertex(q + 1, r + 1);
+            i32 const v3 = result.vertex(q, r + 1);
+
+            if (v0 >= 0 && v1 >= 0 && v3 >= 0)
+                result.faces.emplace_back(v0, v1, v3);
+
+            if (v1 >= 0 && v2 >= 0 && v3 >= 0)
+                result.faces.emplace_back(v1, v2, v3);
+        }
+    }
+}
+
+/// Returns the mean relative error of the given distance to the nearest source. Vertices within
+/// a few cells of any source are skipped since relative error is unbounded there.
+f64 mean_error(Grid const& grid, Span<i32 const> const& sources, Span<f32 const> const& distance)
+{
+    f64 const min_dist = 4.0 / grid.radius;
+    f64 error_sum{0.0};
+    isize count{0};
+
+    for (isize i = 0; i < size(grid.positions); ++i)
+    {
+        f64 exact = INFINITY;
+        for (auto const s : sources)
+            exact = min(exact, f64((grid.positions[i] - grid.positions[s]).norm()));
+
+        if (exact < min_dist)
+            continue;
+
+        error_sum += std::abs(distance[i] - exact) / exact;
+        ++count;
+    }
+
+    return error_sum / count;
+}
+
+/// Solves for heat flow from the given sources in double precision with homogeneous Dirichlet
+/// conditions at boundary vertices other than sources
+void solve_reference_dirichlet(
+    Grid const& grid,
+    Span<i32 const> const& boundary_vertices,
+    Span<i32 const> const& sources,
+    f64 const time,
+    DynamicArray<f64>& result)
+{
+    using SparseMat = Eigen::SparseMatrix<f64>;
+
+    isize const n = size(grid.positions);
+
+    DynamicArray<Vec3<f64>> positions(n);
+    for (isize i = 0; i < n; ++i)
+        positions[i] = grid.positions[i].cast<f64>();
+
+    auto const vert_coords = as_span(positions).as_const();
+    auto const face_verts = as_span(grid.faces).as_const();
+
+    DynamicArray<Triplet<f64, i32>> coeffs{};
+    make_cotan_laplacian(vert_coords, face_verts, coeffs);
+
+    DynamicArray<f64> mass(n);
+    vertex_areas_barycentric(vert_coords, face_verts, as_span(mass));
+
+    DynamicArray<u8> is_fixed(n, 0);
+    for (auto const v : boundary_vertices)
+        is_fixed[v] = 1;
+
+    for (auto const v : sources)
+        is_fixed[v] = 0;
+
+    // A = (M - t S) with fixed vertices decoupled from the rest
+    SparseMat A(n, n);
+    {
+        DynamicArray<Triplet<f64, i32>> a_coeffs{};
+        for (auto const& c : coeffs)
+        {
+            if (c.row() == c.col() || !(is_fixed[c.row()] || is_fixed[c.col()]))
+                a_coeffs.emplace_back(c.row(), c.col(), -time * c.value());
+        }
+
+        for (isize i = 0; i < n; ++i)
+            a_coeffs.emplace_back(i, i, mass[i]);
+
+        A.setFromTriplets(a_coeffs.begin(), a_coeffs.end());
+    }
+
+    Eigen::VectorXd u0 = Eigen::VectorXd::Zero(n);
+    for (auto const v : sources)
+        u0[v] = mass[v];
+
+    Eigen::SimplicialLDLT<SparseMat> decomp{A};
+    result.resize(n);
+    as_vec(as_span(result)) = decomp.solve(u0);
+}
+
+/// Returns the largest difference between the given temperatures and the reference relative to the
+/// peak of the reference
+f64 temperature_error(Span<f32 const> const& temperature, Span<f64 const> const& reference)
+{
+    f64 max_diff{0.0};
+    f64 max_ref{0.0};
+
+    for (isize i = 0; i < reference.size(); ++i)
+    {
+        max_diff = max(max_diff, std::abs(temperature[i] - reference[i]));
+        max_ref = max(max_ref, reference[i]);
+    }
+
+    return max_diff / max_ref;
+}
+
+template <typename Solver>
+bool test_solver(char const* const solver_name, Grid const& grid)
+{
+    static char const* const bc_names[_BoundaryCondition_Count]{
+        "neumann",
+        "dirichlet",
+        "averaged",
+    };
+
+    struct Case
+    {
+        char const* name;
+        DynamicArray<i32> sources;
+    };
+
+    i32 const n = grid.radius;
+    Case const cases[]{
+        {"corner", {grid.vertex(n, 0)}},
+        {"edge", {grid.vertex(n / 2, -n)}},
+        {"edge and interior", {grid.vertex(n / 2, -n), grid.vertex(0, n / 2)}},
+        {"adjacent edges", {grid.vertex(n / 2, -n), grid.vertex(n / 2 + 1, -n)}},
+        {"opposite corners", {grid.vertex(n, 0), grid.vertex(-n, 0)}},
+    };
+
+    auto const vert_coords = as_span(grid.positions).as_const();
+    auto const face_verts = as_span(grid.faces).as_const();
+
+    Solver solver{};
+    typename Solver::Workspace workspace{};
+    DynamicArray<f32> distance(size(grid.positions));
+
+    f32 const init_time = default_time(vert_coords, face_verts);
+    f32 time = init_time;
+    i32 num_retries = 0;
+
+    if (!init_with_retry(solver, vert_coords, face_verts, time, num_retries))
+    {
+        std::fprintf(stderr, "%s: init failed\n", solver_name);
+        return false;
+    }
+
+    DynamicArray<f64> ref_temperature{};
+    bool ok = true;
+
+    for (auto const& c : cases)
+    {
+        for (u8 i = 0; i < _BoundaryCondition_Count; ++i)
+        {
+            auto const sources = as_span(c.sources).as_const();
+
+            auto const solve = [&]() -> bool {
+                solver.solve(sources, as_span(distance), workspace, BoundaryCondition{i});
+                return workspace.is_solved() && as_vec(as_span(distance)).allFinite();
+            };
+
+            // Each configuration starts from the default time
+            if (time != init_time)
+                solver.reinit(time = init_time);
+
+            num_retries = 0;
+            bool const is_solved = solve_with_retry(solver, time, num_retries, solve);
+            f64 const error = is_solved ? mean_error(grid, sources, as_span(distance)) : INFINITY;
+            bool passed = error <= max_mean_error[i];
+
+            if (BoundaryCondition{i} == BoundaryCondition_Dirichlet)
+            {
+                f64 temp_error{INFINITY};
+
+                if (is_solved)
+                {
+                    solve_reference_dirichlet(
+                        grid,
+                        solver.boundary_vertices(),
+                        sources,
+                        time,
+                        ref_temperature);
+
+                    temp_error = temperature_error(
+                        workspace.temperature(),
+                        as_span(ref_temperature).as_const());
+                }
+
+                passed &= temp_error <= max_temperature_error;
+                std::printf(
+                    "%s, %s, %s: %s (mean error %.4f, temperature error %.2e)\n",
+                    solver_name,
+                    c.name,
+                    bc_names[i],
+                    passed ? "passed" : "FAILED",
+                    error,
+                    temp_error);
+            }
+            else
+            {
+                std::printf(
+                    "%s, %s, %s: %s (mean error %.4f)\n",
+                    solver_name,
+                    c.name,
+                    bc_names[i],
+                    passed ? "passed" : "FAILED",
+                    error);
+            }
+
+            ok &= passed;
+        }
+    }
+
+    return ok;
+}
+
+} // namespace
+} // namespace dr
+
+int main()
+{
+    using namespace dr;
+
+    Grid grid{};
+    make_grid(16, grid);
+
+    bool ok = test_solver<HeatMethod<f32, i32>>("direct", grid);
+    ok &= test_solver<HeatMethod<f32, i32, SparseAMG<f32, i32>>>("multigrid", grid);
+    ok &= test_solver<HeatMethodMatrixFree<f32, i32>>("iterative", grid);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
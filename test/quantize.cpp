@@ -0,0 +1,70 @@
+/*
+    Checks that dequantize_unorm16 inverts quantize_unorm16 to within the documented error and
+    that values outside the quantized range are clamped.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <dr/dynamic_array.hpp>
+#include <dr/math.hpp>
+#include <dr/span.hpp>
+
+#include "quantize.hpp"
+
+namespace dr
+{
+namespace
+{
+
+bool test_round_trip(f32 const max_value)
+{
+    constexpr isize num_values = 100'000;
+
+    // Values span the quantized range with a margin on either side which should be clamped
+    DynamicArray<f32> values(num_values);
+    for (isize i = 0; i < num_values; ++i)
+        values[i] = max_value * (f32(i) / f32(num_values - 1) * 1.2f - 0.1f);
+
+    DynamicArray<u16> quantized(num_values);
+    quantize_unorm16(as_span(values).as_const(), max_value, as_span(quantized));
+
+    DynamicArray<f32> result(num_values);
+    dequantize_unorm16(as_span(quantized).as_const(), max_value, as_span(result));
+
+    // NOTE(dr): Allows for single precision rounding of scaled values on top of half a
+    // quantization step
+    f64 const max_error = max_value / 131070.0 * 1.01;
+    f64 error{0.0};
+
+    for (isize i = 0; i < num_values; ++i)
+    {
+        f32 const expect = clamp(values[i], 0.0f, max_value);
+        error = max(error, std::abs(f64(result[i]) - f64(expect)));
+    }
+
+    bool const passed = error <= max_error;
+    std::printf(
+        "max value %g: %s (max error %.3e, limit %.3e)\n",
+        max_value,
+        passed ? "passed" : "FAILED",
+        error,
+        max_error);
+
+    return passed;
+}
+
+} // namespace
+} // namespace dr
+
+int main()
+{
+    using namespace dr;
+
+    bool ok = true;
+    for (f32 const max_value : {1.0f, 3.14159f, 1000.0f})
+        ok &= test_round_trip(max_value);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}